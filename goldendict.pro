@@ -343,6 +343,7 @@ HEADERS += \
     src/dict/romaji.hh \
     src/dict/russiantranslit.hh \
     src/dict/sdict.hh \
+    src/dict/gdc.hh \
     src/dict/slob.hh \
     src/dict/sounddir.hh \
     src/dict/sources.hh \
@@ -466,6 +467,7 @@ SOURCES += \
     src/dict/romaji.cc \
     src/dict/russiantranslit.cc \
     src/dict/sdict.cc \
+    src/dict/gdc.cc \
     src/dict/slob.cc \
     src/dict/sounddir.cc \
     src/dict/sources.cc \
@@ -13,6 +13,7 @@
 #include "wstring_qt.hh"
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QTextDocumentFragment>
 #include <QUrl>
 
@@ -34,12 +35,54 @@ ArticleMaker::ArticleMaker( vector< sptr< Dictionary::Class > > const & dictiona
   groups( groups_ ),
   cfg( cfg_ )
 {
+  connect( &cssWatcher, &QFileSystemWatcher::fileChanged, this, &ArticleMaker::dropHtmlHeaderCache );
+  connect( &cssWatcher, &QFileSystemWatcher::directoryChanged, this, &ArticleMaker::cssDirectoryChanged );
+}
+
+void ArticleMaker::watchCssFile( QString const & fileName ) const
+{
+  // A css file which doesn't exist yet is noticed through its directory.
+  QFileInfo fi( fileName );
+  QString path = fi.exists() ? fi.absoluteFilePath() : fi.absolutePath();
+
+  if ( !fi.exists() )
+    missingCssFiles.insert( fi.absoluteFilePath() );
+
+  if ( QFileInfo::exists( path ) && !cssWatcher.files().contains( path )
+       && !cssWatcher.directories().contains( path ) )
+    cssWatcher.addPath( path );
 }
 
 
 std::string ArticleMaker::makeHtmlHeader( QString const & word,
                                           QString const & icon,
                                           bool expandOptionalParts ) const
+{
+  bool darkReaderMode = GlobalBroadcaster::instance()->getPreference()->darkReaderMode;
+
+  auto key = std::make_tuple( cfg.displayStyle, cfg.addonStyle, expandOptionalParts, darkReaderMode );
+  auto it  = htmlHeaderCache.find( key );
+  if ( it == htmlHeaderCache.end() )
+  {
+    HtmlHeaderParts parts{ makeHtmlHeaderHead( expandOptionalParts ), makeHtmlHeaderTail( darkReaderMode ) };
+    it = htmlHeaderCache.emplace( key, std::move( parts ) ).first;
+  }
+
+  string result = it->second.head;
+
+  result += "<title>" + Html::escape( word.toStdString()) + "</title>";
+
+  // This doesn't seem to be much of influence right now, but we'll keep
+  // it anyway.
+  if ( icon.size() )
+    result += R"(<link rel="icon" type="image/png" href="qrc:///flags/)" + Html::escape( icon.toUtf8().data() ) + "\" >\n";
+
+  result += it->second.tail;
+
+  return result;
+}
+
+std::string ArticleMaker::makeHtmlHeaderHead( bool expandOptionalParts ) const
 {
   string result = R"(<!DOCTYPE html>
 <html><head>
@@ -124,12 +167,12 @@ std::string ArticleMaker::makeHtmlHeader( QString const & word,
     }
   }
 
-  result += "<title>" + Html::escape( word.toStdString()) + "</title>";
+  return result;
+}
 
-  // This doesn't seem to be much of influence right now, but we'll keep
-  // it anyway.
-  if ( icon.size() )
-    result += R"(<link rel="icon" type="image/png" href="qrc:///flags/)" + Html::escape( icon.toUtf8().data() ) + "\" >\n";
+std::string ArticleMaker::makeHtmlHeaderTail( bool darkReaderMode ) const
+{
+  string result;
 
   result += QString::fromUtf8( R"(
 <script>
@@ -145,7 +188,7 @@ std::string ArticleMaker::makeHtmlHeader( QString const & word,
 
   result+= R"(<script src="qrc:///scripts/gd-builtin.js"></script>)";
 
-  if( GlobalBroadcaster::instance()->getPreference()->darkReaderMode )
+  if( darkReaderMode )
   {
     //only enable this darkmode on modern style.
     if( cfg.displayStyle == "modern" ) {
@@ -206,7 +249,35 @@ body { background: #242525; }
   return result;
 }
 
+void ArticleMaker::cssDirectoryChanged( QString const & path )
+{
+  // The directory is usually the config one, which changes on every save of
+  // the history or the favorites. Only a missing css file showing up counts.
+  QDir dir( path );
+
+  for ( QString const & fileName : qAsConst( missingCssFiles ) )
+    if ( QFileInfo( fileName ).dir() == dir && QFileInfo::exists( fileName ) )
+    {
+      dropHtmlHeaderCache();
+      return;
+    }
+}
+
+void ArticleMaker::dropHtmlHeaderCache()
+{
+  htmlHeaderCache.clear();
+  missingCssFiles.clear();
+
+  // Editors often save by replacing the file, which silently drops it from
+  // the watch list, so the paths are registered anew on the next build.
+  QStringList watched = cssWatcher.files() + cssWatcher.directories();
+  if ( !watched.isEmpty() )
+    cssWatcher.removePaths( watched );
+}
+
  std::string ArticleMaker::readCssFile(QString  const & fileName, std::string media)  const{
+  watchCssFile( fileName );
+
   QFile addonCss(fileName);
   std::string result;
   if (addonCss.open(QFile::ReadOnly)) {
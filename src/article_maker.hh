@@ -5,9 +5,13 @@
 #define __ARTICLE_MAKER_HH_INCLUDED__
 
 #include <QObject>
+#include <QFileSystemWatcher>
 #include <QMap>
+#include <QSet>
+#include <map>
 #include <set>
 #include <list>
+#include <tuple>
 #include "config.hh"
 #include "dict/dictionary.hh"
 #include "instances.hh"
@@ -22,6 +26,21 @@ class ArticleMaker: public QObject
   std::vector< Instances::Group > const & groups;
   const Config::Preferences & cfg;
 
+  /// The parts of the html header before and after the per-article title and
+  /// icon, which only depend on the display settings and the user css files.
+  struct HtmlHeaderParts
+  {
+    std::string head, tail;
+  };
+
+  /// Keyed by display style, addon style, expand optional parts and dark reader mode.
+  mutable std::map< std::tuple< QString, QString, bool, bool >, HtmlHeaderParts > htmlHeaderCache;
+  /// Watches the css files read into the header, to drop the cache on changes.
+  mutable QFileSystemWatcher cssWatcher;
+  /// The css files read into the header which don't exist, so their
+  /// directories are watched instead.
+  mutable QSet< QString > missingCssFiles;
+
 public:
 
   /// On construction, a reference to all dictionaries and a reference all
@@ -63,11 +82,20 @@ public:
   /// Return true if path successfully adjusted
   static bool adjustFilePath( QString & fileName );
 
+private slots:
+  void dropHtmlHeaderCache();
+  void cssDirectoryChanged( QString const & path );
+
 private:
   std::string readCssFile(QString const& fileName, std::string type) const;
+  void watchCssFile( QString const & fileName ) const;
   /// Makes everything up to and including the opening body tag.
   std::string makeHtmlHeader( QString const & word, QString const & icon,
                               bool expandOptionalParts ) const;
+  /// Makes the cacheable part of the header which precedes the title.
+  std::string makeHtmlHeaderHead( bool expandOptionalParts ) const;
+  /// Makes the cacheable part of the header which follows the title and icon.
+  std::string makeHtmlHeaderTail( bool darkReaderMode ) const;
 
   /// Makes the html body for makeNotFoundTextFor()
   static std::string makeNotFoundBody( QString const & word, QString const & group );
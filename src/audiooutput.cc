@@ -192,3 +192,11 @@ bool AudioOutput::play( const uint8_t * data, qint64 len )
 
   return true;
 }
+
+void AudioOutput::clear()
+{
+  Q_D( AudioOutput );
+
+  QMutexLocker locker( &d->mutex );
+  d->buffer.clear();
+}
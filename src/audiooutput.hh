@@ -12,6 +12,8 @@ class AudioOutput: public QObject
   ~AudioOutput();
 
   bool play( const uint8_t * data, qint64 len );
+  /// Drops the samples which haven't been played yet
+  void clear();
   void setAudioFormat( int sampleRate, int channels );
  protected:
   QScopedPointer< AudioOutputPrivate > d_ptr;
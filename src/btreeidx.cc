@@ -5,6 +5,7 @@
 #include "folding.hh"
 #include "utf8.hh"
 #include <QRunnable>
+#include <QThread>
 #include <QThreadPool>
 #include <QSemaphore>
 #include <math.h>
@@ -19,6 +20,7 @@
 #include "globalbroadcaster.hh"
 
 #include <QtConcurrent>
+#include <memory>
 #include <zlib.h>
 
 namespace BtreeIndexing {
@@ -144,6 +146,7 @@ void BtreeWordSearchRequest::findMatches()
   }
   
   QRegularExpression regexp;
+  std::unique_ptr< WildcardMatcher > matcher;
 
   bool useWildcards = false;
   if( allowMiddleMatches )
@@ -158,10 +161,18 @@ void BtreeWordSearchRequest::findMatches()
 
   if( useWildcards )
   {
-    regexp.setPattern( wildcardsToRegexp( QString::fromStdU32String( Folding::applyDiacriticsOnly( Folding::applySimpleCaseOnly( str ) ) ) ) );
-    if( !regexp.isValid() )
-      regexp.setPattern( QRegularExpression::escape( regexp.pattern() ) );
-    regexp.setPatternOptions( QRegularExpression::CaseInsensitiveOption );
+    // The compiled matcher is way faster than the regexp, which is only
+    // needed for the patterns too long for it
+    matcher = std::make_unique< WildcardMatcher >( str );
+    if( !matcher->isValid() )
+    {
+      matcher.reset();
+
+      regexp.setPattern( wildcardsToRegexp( QString::fromStdU32String( Folding::applyDiacriticsOnly( Folding::applySimpleCaseOnly( str ) ) ) ) );
+      if( !regexp.isValid() )
+        regexp.setPattern( QRegularExpression::escape( regexp.pattern() ) );
+      regexp.setPatternOptions( QRegularExpression::CaseInsensitiveOption );
+    }
 
     bool bNoLetters = folded.empty();
     wstring foldedWithWildcards;
@@ -305,6 +316,13 @@ void BtreeWordSearchRequest::findMatches()
 
           for( unsigned x = 0; x < chain.size(); ++x )
           {
+            if( matcher )
+            {
+              string word = chain[ x ].prefix + chain[ x ].word;
+              if( matcher->matchesPrefixOf( word ) )
+                addMatch( Utf8::decode( word ) );
+            }
+            else
             if( useWildcards )
             {
               wstring word = Utf8::decode( chain[ x ].prefix + chain[ x ].word );
@@ -322,7 +340,8 @@ void BtreeWordSearchRequest::findMatches()
             {
               // Skip middle matches, if requested. If suffix variation is specified,
               // make sure the string isn't larger than requested.
-              if ( ( allowMiddleMatches || Folding::apply( Utf8::decode( chain[ x ].prefix ) ).empty() ) &&
+              if ( ( allowMiddleMatches || chain[ x ].prefix.empty()
+                     || Folding::apply( Utf8::decode( chain[ x ].prefix ) ).empty() ) &&
                    ( maxSuffixVariation < 0 || (int)resultFolded.size() - initialFoldedSize <= maxSuffixVariation ) )
                   addMatch( Utf8::decode( chain[ x ].prefix + chain[ x ].word ) );
             }
@@ -436,6 +455,42 @@ sptr< Dictionary::WordSearchRequest > BtreeDictionary::stemmedMatch(
                                      false, maxResults );
 }
 
+bool BtreeDictionary::isPrefixMatchOf( wstring const & word, wstring const & foldedQuery )
+{
+  // This mirrors the way IndexedWords::addWord() makes the index entries:
+  // one for each word of a phrase, running up to its end.
+
+  wchar const * nextChar = word.c_str();
+  bool hasEntries = false;
+
+  for( ; ; )
+  {
+    // Skip any whitespace/punctuation
+    while( *nextChar && ( Folding::isWhitespace( *nextChar ) || Folding::isPunct( *nextChar ) ) )
+      ++nextChar;
+
+    if ( !*nextChar )
+      break;
+
+    wstring entry = Folding::apply( nextChar );
+    if ( entry.size() >= foldedQuery.size() && !entry.compare( 0, foldedQuery.size(), foldedQuery ) )
+      return true;
+
+    hasEntries = true;
+
+    // Skip all non-whitespace/punctuation
+    for( ++nextChar; *nextChar && !Folding::isWhitespace( *nextChar ) && !Folding::isPunct( *nextChar );
+         ++nextChar ) ;
+  }
+
+  if ( hasEntries )
+    return false;
+
+  // Words with no letters at all are indexed as they are
+  wstring entry = Folding::applyWhitespaceOnly( word );
+  return entry.size() >= foldedQuery.size() && !entry.compare( 0, foldedQuery.size(), foldedQuery );
+}
+
 void BtreeIndex::readNode( uint32_t offset, vector< char > & out )
 {
   idxFile->seek( offset );
@@ -975,8 +1030,24 @@ static uint32_t buildBtreeNode( IndexedWords::const_iterator & nextIndex,
   return offset;
 }
 
+namespace {
+
+/// Throws if the indexing thread was asked to stop. It's only checked every
+/// so many words, as the words come by millions.
+void checkIndexingInterruption()
+{
+  thread_local unsigned words = 0;
+
+  if ( ( ++words & 0x3FF ) == 0 && QThread::currentThread()->isInterruptionRequested() )
+    throw exIndexingInterrupted();
+}
+
+} // namespace
+
 void IndexedWords::addWord( wstring const & index_word, uint32_t articleOffset, unsigned int maxHeadwordSize )
 {
+  checkIndexingInterruption();
+
   wstring const & word = gd::removeTrailingZero( index_word );
   wchar const * wordBegin = word.c_str();
   string::size_type wordSize = word.size();
@@ -1068,6 +1139,8 @@ void IndexedWords::addWord( wstring const & index_word, uint32_t articleOffset,
 
 void IndexedWords::addSingleWord( wstring const & index_word, uint32_t articleOffset )
 {
+  checkIndexingInterruption();
+
   wstring const & word = gd::removeTrailingZero( index_word );
   wstring folded = Folding::apply( word );
   if( folded.empty() )
@@ -1255,96 +1328,137 @@ void BtreeIndex::findArticleLinks( QVector< WordArticleLink > * articleLinks,
   }
 }
 
-void BtreeIndex::findHeadWords( QSet<uint32_t> offsets,int& index,
-                                   QSet< QString > * headwords,
-                                   uint32_t length )
-{
-  int i=0;
-  for(auto begin=offsets.begin();begin!=offsets.end();begin++,i++){
-    if(i<index){
-      continue;
-    }
-    findSingleNodeHeadwords(*begin,headwords);
-    index++;
-
-    if(headwords->size()>=length)
-      break;
-  }
-}
-
-void BtreeIndex::findSingleNodeHeadwords( uint32_t offsets,
-                                QSet< QString > * headwords)
+uint32_t BtreeIndex::findFirstLeaf()
 {
-  uint32_t currentNodeOffset = offsets;
+  if ( !idxFile )
+    throw exIndexWasNotOpened();
 
   QMutexLocker _( idxFileMutex );
 
-  char const * leaf = 0;
-  char const * leafEnd = 0;
-  char const * chainPtr = 0;
+  if ( !rootNodeLoaded )
+  {
+    // Time to load our root node. We do it only once, at the first request.
+    readNode( rootOffset, rootNode );
+    rootNodeLoaded = true;
+  }
 
-  vector< char > extLeaf;
+  uint32_t currentNodeOffset = rootOffset;
+  char const * leaf = &rootNode.front();
 
-  // A node
-  readNode( currentNodeOffset, extLeaf );
-  leaf    = &extLeaf.front();
-  leafEnd = leaf + extLeaf.size();
+  vector< char > extLeaf;
 
-  // A leaf
-  chainPtr = leaf + sizeof( uint32_t );
+  // Follow the leftmost links down to the first leaf
 
-  for( ;; )
+  for( ; ; )
   {
-    vector< WordArticleLink > result = readChain( chainPtr );
+    uint32_t leafEntries = *(uint32_t *)leaf;
 
-    if( headwords )
-    {
-      for( unsigned i = 0; i < result.size(); i++ )
-      {
-        headwords->insert( QString::fromUtf8( ( result[ i ].prefix + result[ i ].word ).c_str() ) );
-      }
-    }
+    if ( leafEntries != 0xffffFFFF )
+      return leafEntries ? currentNodeOffset : 0;
 
-    if( chainPtr >= leafEnd )
-    {
-        break; // That was the last leaf
-    }
+    currentNodeOffset = *( (uint32_t *)leaf + 1 );
+    readNode( currentNodeOffset, extLeaf );
+    leaf = &extLeaf.front();
   }
 }
 
-//find the next chain ptr ,which is large than this currentChainPtr
-QSet<uint32_t> BtreeIndex::findNodes()
+uint32_t BtreeIndex::findLeafOf( wstring const & target )
 {
+  if ( !idxFile )
+    throw exIndexWasNotOpened();
+
   QMutexLocker _( idxFileMutex );
 
-  if( !rootNodeLoaded )
+  if ( !rootNodeLoaded )
   {
     // Time to load our root node. We do it only once, at the first request.
     readNode( rootOffset, rootNode );
     rootNodeLoaded = true;
   }
 
-  char const * leaf     = &rootNode.front();
-  QSet<uint32_t> leafOffset;
+  uint32_t currentNodeOffset = rootOffset;
+  char const * leaf = &rootNode.front();
+  char const * leafEnd = leaf + rootNode.size();
 
-  uint32_t leafEntries;
-  leafEntries = *(uint32_t *)leaf;
-  if ( leafEntries != 0xffffFFFF )
+  vector< char > extLeaf;
+
+  for( ; ; )
   {
-    leafOffset.insert(rootOffset);
-    return leafOffset;
+    if ( *(uint32_t *)leaf != 0xffffFFFF )
+      return currentNodeOffset;
+
+    // A node. Go right of every string not larger than the target, as
+    // findChainOffsetExactOrPrefix() does.
+
+    uint32_t const * offsets = (uint32_t *)leaf + 1;
+
+    char const * ptr = leaf + sizeof( uint32_t ) +
+                       ( indexNodeSize + 1 ) * sizeof( uint32_t );
+
+    unsigned entry = 0;
+
+    for( ; ptr < leafEnd; ptr += strlen( ptr ) + 1, ++entry )
+      if ( target.compare( Utf8::decode( string( ptr ) ) ) < 0 )
+        break;
+
+    currentNodeOffset = offsets[ entry ];
+    readNode( currentNodeOffset, extLeaf );
+    leaf = &extLeaf.front();
+    leafEnd = leaf + extLeaf.size();
   }
+}
 
-  // the current the btree's implementation has the  height = 2.
+void BtreeIndex::readLeafHeadwords( uint32_t & leafOffset, QStringList & headwords )
+{
+  if ( !idxFile )
+    throw exIndexWasNotOpened();
 
-  // A node offset
-  uint32_t * offsets = (uint32_t *)leaf + 1;
-  uint32_t i=0;
+  vector< char > leaf;
+  uint32_t nextLeaf;
 
-  while(i++ < (indexNodeSize+1) )
-    leafOffset.insert(*(offsets++));
+  {
+    QMutexLocker _( idxFileMutex );
 
-  return leafOffset;
+    readNode( leafOffset, leaf );
+    // Each leaf is followed by the link to the next one, even the root one
+    nextLeaf = idxFile->read< uint32_t >();
+  }
+
+  leafOffset = nextLeaf;
+
+  uint32_t leafEntries = *(uint32_t *)&leaf.front();
+
+  if ( leafEntries == 0xffffFFFF )
+    throw exCorruptedChainData();
+
+  char const * chainPtr = &leaf.front() + sizeof( uint32_t );
+  char const * leafEnd = &leaf.front() + leaf.size();
+
+  while( leafEntries-- && chainPtr < leafEnd )
+  {
+    vector< WordArticleLink > chain = readChain( chainPtr );
+
+    // The same headword may be linked to several articles, but all such
+    // links share the chain
+    int const chainStart = headwords.size();
+
+    for( auto const & link : chain )
+    {
+      // Entries with a prefix are middle matches, the headword itself is
+      // stored in another chain. Leading punctuation doesn't count.
+      if ( !link.prefix.empty() && !Folding::apply( Utf8::decode( link.prefix ) ).empty() )
+        continue;
+
+      QString word = QString::fromUtf8( ( link.prefix + link.word ).c_str() );
+
+      bool seen = false;
+      for( int x = chainStart; x < headwords.size() && !seen; ++x )
+        seen = headwords.at( x ) == word;
+
+      if ( !seen )
+        headwords.append( word );
+    }
+  }
 }
 
 void BtreeIndex::getHeadwordsFromOffsets( QList<uint32_t> & offsets,
@@ -1497,10 +1611,42 @@ bool BtreeDictionary::getHeadwords( QStringList &headwords )
   return headwords.size() > 0;
 }
 
-void BtreeDictionary::findHeadWordsWithLenth( int & index, QSet< QString > * headwords, uint32_t length )
+bool BtreeDictionary::findHeadWordsWithLenth( uint32_t & position, QStringList & headwords, uint32_t length )
+{
+  // The position is the offset of the next leaf to read, zero means
+  // the beginning of the index
+  if ( !position )
+    position = findFirstLeaf();
+
+  int const initialSize = headwords.size();
+
+  while( position && (uint32_t)( headwords.size() - initialSize ) < length )
+    readLeafHeadwords( position, headwords );
+
+  return position != 0;
+}
+
+bool BtreeDictionary::findHeadWordsFrom( QString const & prefix, uint32_t & position, QStringList & headwords )
 {
-  auto leafNodeOffsets = findNodes();
-  findHeadWords(leafNodeOffsets,index,headwords,length);
+  wstring folded = Folding::apply( gd::toWString( prefix ) );
+
+  if ( folded.empty() )
+  {
+    position = findFirstLeaf();
+    return position != 0;
+  }
+
+  position = findLeafOf( folded );
+
+  QStringList leafHeadwords;
+  readLeafHeadwords( position, leafHeadwords );
+
+  // The leaf may begin before the prefix
+  for( auto const & word : leafHeadwords )
+    if ( Folding::apply( gd::toWString( word ) ) >= folded )
+      headwords.append( word );
+
+  return position != 0;
 }
 
 void BtreeDictionary::getArticleText(uint32_t, QString &, QString & )
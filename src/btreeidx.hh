@@ -16,6 +16,7 @@
 #include <QFuture>
 #include <QList>
 #include <QSet>
+#include <QStringList>
 #include <QVector>
 
 
@@ -41,6 +42,7 @@ enum
 DEF_EX( exIndexWasNotOpened, "The index wasn't opened", Dictionary::Ex )
 DEF_EX( exFailedToDecompressNode, "Failed to decompress a btree's node", Dictionary::Ex )
 DEF_EX( exCorruptedChainData, "Corrupted chain data in the leaf of a btree encountered", Dictionary::Ex )
+DEF_EX( exIndexingInterrupted, "The indexing was interrupted", Dictionary::Ex )
 
 /// This structure describes a word linked to its translation. The
 /// translation is represented as an abstract 32-bit offset.
@@ -97,10 +99,20 @@ public:
                          QSet< QString > * headwords,
                          QAtomicInt * isCancelled = 0 );
 
-  void findHeadWords( QSet<uint32_t> offsets,int& index, QSet< QString > * headwords, uint32_t length );
-  void findSingleNodeHeadwords( uint32_t offsets,
-                                            QSet< QString > * headwords);
-  QSet<uint32_t> findNodes( );
+  /// Returns the offset of the leftmost leaf of the btree, which is where
+  /// the chain of leaves begins. Returns 0 if the index is empty.
+  uint32_t findFirstLeaf();
+
+  /// Returns the offset of the leaf where the given word is, or would be,
+  /// in the chain of leaves. The word must already be folded.
+  uint32_t findLeafOf( wstring const & target );
+
+  /// Reads the headwords of the leaf at the given offset, in the index
+  /// (folded) order. Middle-match aliases, i.e. entries with a non-empty
+  /// folded prefix, are skipped, so each headword is only reported once.
+  /// The offset is updated to point to the next leaf in the chain, or set
+  /// to 0 if that was the last one.
+  void readLeafHeadwords( uint32_t & leafOffset, QStringList & headwords );
 
   /// Retrieve headwords for presented article addresses
   void getHeadwordsFromOffsets( QList< uint32_t > & offsets,
@@ -180,8 +192,22 @@ public:
   virtual bool isLocalDictionary()
   { return true; }
 
+  /// Returns true if the results of prefixMatch() for a query are always a
+  /// subset of the results for any prefix of it, so the results of a
+  /// previous query can be refined with isPrefixMatchOf() while the user
+  /// keeps typing. That's the case for the plain btree search. Derivatives
+  /// which add matches of their own should return false.
+  virtual bool canRefinePrefixMatches() const
+  { return true; }
+
+  /// Checks whether the given word, as returned by prefixMatch(), would be
+  /// found by the prefix search of the given query, already folded the way
+  /// the search does it.
+  static bool isPrefixMatchOf( wstring const & word, wstring const & foldedQuery );
+
   virtual bool getHeadwords( QStringList &headwords );
-  virtual  void findHeadWordsWithLenth( int &, QSet< QString > * headwords, uint32_t length );
+  virtual bool findHeadWordsWithLenth( uint32_t & position, QStringList & headwords, uint32_t length );
+  virtual bool findHeadWordsFrom( QString const & prefix, uint32_t & position, QStringList & headwords );
 
   virtual void getArticleText( uint32_t articleAddress, QString & headword, QString & text );
 
@@ -258,6 +284,8 @@ public:
 /// words to sequences of their unfolded source forms and the corresponding
 /// article offsets. The words are utf8-encoded -- it doesn't break Unicode
 /// sorting, but conserves space.
+/// Adding words throws exIndexingInterrupted once the interruption of the
+/// thread doing it is requested, so that indexing can be cancelled.
 struct IndexedWords: public map< string, vector< WordArticleLink > >
 {
   /// Instead of adding to the map directly, use this function. It does folding
@@ -4,19 +4,79 @@
 #include "chunkedstorage.hh"
 #include <zlib.h>
 #include <string.h>
-#include <QDataStream>
+#include <algorithm>
 #include <QScopeGuard>
+#include <QtEndian>
 #include <QMutexLocker>
+#include <QThread>
+#include <QtConcurrent>
 
 namespace ChunkedStorage {
 
-enum
+namespace {
+
+/// Set in the compressed size of a chunk which is stored uncompressed. Older
+/// readers don't know it, hence FormatVersion was bumped.
+uint32_t const StoredChunkFlag = 0x80000000;
+
+/// The chunks are addressed by 16 bits
+size_t const MaxChunks = 65536;
+
+CompressedChunk compressChunk( vector< unsigned char > const & data )
 {
-  ChunkMaxSize = 65536 // Can't be more since it would overflow the address
-};
+  CompressedChunk result;
+
+  result.uncompressedSize = data.size();
+  result.data.resize( compressBound( data.size() ) );
+
+  unsigned long compressedSize = result.data.size();
+
+  if ( compress( result.data.data(), &compressedSize, data.data(), data.size() ) != Z_OK )
+    throw exFailedToCompressChunk();
+
+  result.stored = !data.empty() && compressedSize >= data.size();
+
+  if ( result.stored )
+    result.data = data;
+  else
+    result.data.resize( compressedSize );
+
+  return result;
+}
+
+/// Unpacks the chunk data to the given storage. The compressed size is the
+/// one from the chunk header, so it tells whether the chunk is stored.
+void unpackChunk( uchar const * data, uint32_t uncompressedSize,
+                  uint32_t compressedSize, vector< char > & chunk )
+{
+  bool stored = compressedSize & StoredChunkFlag;
+  compressedSize &= ~StoredChunkFlag;
+
+  chunk.resize( uncompressedSize );
+
+  if ( stored )
+  {
+    if ( compressedSize != chunk.size() )
+      throw exFailedToDecompressChunk();
+
+    if ( compressedSize )
+      memcpy( &chunk.front(), data, compressedSize );
+
+    return;
+  }
 
-Writer::Writer( File::Class & f ):
-  file( f ), chunkStarted( false ), bufferUsed( 0 )
+  unsigned long decompressedLength = chunk.size();
+
+  if ( uncompress( (unsigned char *)&chunk.front(), &decompressedLength, data, compressedSize ) != Z_OK
+       || decompressedLength != chunk.size() )
+    throw exFailedToDecompressChunk();
+}
+
+}
+
+Writer::Writer( File::Class & f, size_t chunkSize_ ):
+  file( f ), chunkSize( std::min< size_t >( chunkSize_, ChunkMaxSize ) ),
+  chunkStarted( false ), bufferUsed( 0 )
 {
   // Create a sratchpad at the beginning of file. We use it to write chunk
   // table if it would fit, in order to save some seek times.
@@ -31,14 +91,24 @@ Writer::Writer( File::Class & f ):
   file.write( zero, sizeof( zero ) );
 }
 
+Writer::~Writer()
+{
+  for( auto & chunk : pendingChunks )
+    chunk.waitForFinished();
+}
+
 uint32_t Writer::startNewBlock()
 {
-  if ( bufferUsed >= ChunkMaxSize )
+  if ( bufferUsed >= chunkSize )
   {
     // Need to flush first.
     saveCurrentChunk();
   }
 
+  // The chunk the block goes to can't be addressed
+  if ( offsets.size() >= MaxChunks )
+    throw exStorageFull();
+
   chunkStarted = true;
 
   // The address is comprised of the offset within the chunk (in lower
@@ -64,26 +134,41 @@ void Writer::addToBlock( void const * data, size_t size )
 
 void Writer::saveCurrentChunk()
 {
-  size_t maxCompressedSize = compressBound( bufferUsed );
+  // Don't let the chunks pile up if compressing is slower than filling them
+  if ( pendingChunks.size() >= (size_t)QThread::idealThreadCount() )
+    writePendingChunk();
 
-  if ( bufferCompressed.size() < maxCompressedSize )
-    bufferCompressed.resize( maxCompressedSize );
+  pendingChunks.push_back( QtConcurrent::run( compressChunk,
+                             vector< unsigned char >( buffer.begin(), buffer.begin() + bufferUsed ) ) );
 
-  unsigned long compressedSize = bufferCompressed.size();
+  // The address of the next block depends on the number of chunks
+  offsets.push_back( 0 );
 
-  if ( compress( &bufferCompressed.front(), &compressedSize,
-                 &buffer.front(), bufferUsed ) != Z_OK )
-    throw exFailedToCompressChunk();
+  bufferUsed = 0;
+
+  chunkStarted = false;
+}
 
-  offsets.push_back( file.tell() );
+void Writer::writePendingChunk()
+{
+  // The offsets of the pending chunks are the last ones
+  size_t chunkIdx = offsets.size() - pendingChunks.size();
 
-  file.write( (uint32_t) bufferUsed );
-  file.write( (uint32_t) compressedSize );
-  file.write( &bufferCompressed.front(), compressedSize );
+  CompressedChunk chunk = pendingChunks.front().result();
 
-  bufferUsed = 0;
+  pendingChunks.pop_front();
 
-  chunkStarted = false;
+  // The chunk offsets are 32-bit
+  if ( file.tell() + 8 + chunk.data.size() > UINT32_MAX )
+    throw exStorageFull();
+
+  offsets[ chunkIdx ] = file.tell();
+
+  file.write( chunk.uncompressedSize );
+  file.write( (uint32_t) chunk.data.size() | ( chunk.stored ? StoredChunkFlag : 0 ) );
+
+  if ( !chunk.data.empty() )
+    file.write( chunk.data.data(), chunk.data.size() );
 }
 
 uint32_t Writer::finish()
@@ -91,6 +176,9 @@ uint32_t Writer::finish()
   if ( bufferUsed || chunkStarted )
     saveCurrentChunk();
 
+  while( !pendingChunks.empty() )
+    writePendingChunk();
+
   bool useScratchPad = false;
   uint32_t savedOffset = 0;
 
@@ -117,15 +205,25 @@ uint32_t Writer::finish()
   return offset;
 }
 
-Reader::Reader( File::Class & f, uint32_t offset ): file( f )
+Reader::Reader( File::Class & f, uint32_t offset ): file( f ),
+  mappedData( nullptr ), mappedSize( 0 )
 {
   file.seek( offset );
 
   uint32_t size =  file.read< uint32_t >();
-  if ( size == 0 )
-    return;
-  offsets.resize( size );
-  file.read( &offsets.front(), offsets.size() * sizeof( uint32_t ) );
+  if ( size )
+  {
+    offsets.resize( size );
+    file.read( &offsets.front(), offsets.size() * sizeof( uint32_t ) );
+  }
+
+  QMutexLocker _( &file.lock );
+
+  mappedSize = file.file().size();
+  mappedData = file.map( 0, mappedSize );
+
+  if ( !mappedData )
+    mappedSize = 0; // Blocks will be read by mapping each chunk then
 }
 
 char * Reader::getBlock( uint32_t address, vector< char > & chunk )
@@ -135,44 +233,45 @@ char * Reader::getBlock( uint32_t address, vector< char > & chunk )
   if ( chunkIdx >= offsets.size() )
     throw exAddressOutOfRange();
 
-  // Read and decompress the chunk
+  qint64 chunkOffset = offsets[ chunkIdx ];
+
+  if ( mappedData )
+  {
+    if ( chunkOffset + 8 > mappedSize )
+      throw exAddressOutOfRange();
+
+    uint32_t uncompressedSize = qFromLittleEndian< quint32 >( mappedData + chunkOffset );
+    uint32_t compressedSize = qFromLittleEndian< quint32 >( mappedData + chunkOffset + 4 );
+
+    if ( chunkOffset + 8 + ( compressedSize & ~StoredChunkFlag ) > mappedSize )
+      throw exAddressOutOfRange();
+
+    unpackChunk( mappedData + chunkOffset + 8, uncompressedSize, compressedSize, chunk );
+  }
+  else
   {
-    // file.seek( offsets[ chunkIdx ] );
     QMutexLocker _( &file.lock );
-    auto bytes = file.map( offsets[ chunkIdx ], 8 );
-    if( bytes == nullptr )
-      throw mapFailed();
-    auto qBytes = QByteArray::fromRawData( reinterpret_cast< char * >(bytes), 8 );
-    QDataStream in( qBytes );
-    in.setByteOrder( QDataStream::LittleEndian );
 
-    uint32_t uncompressedSize;
-    uint32_t compressedSize;
+    uchar * header = file.map( chunkOffset, 8 );
+    if( header == nullptr )
+      throw mapFailed();
 
-    in >> uncompressedSize >> compressedSize;
+    uint32_t uncompressedSize = qFromLittleEndian< quint32 >( header );
+    uint32_t compressedSize = qFromLittleEndian< quint32 >( header + 4 );
 
-    file.unmap( bytes );
-    chunk.resize( uncompressedSize );
+    file.unmap( header );
 
-    // vector< unsigned char > compressedData( compressedSize );
-    auto chunkDataBytes = file.map( offsets[ chunkIdx ] + 8, compressedSize );
+    uchar * chunkDataBytes = file.map( chunkOffset + 8, compressedSize & ~StoredChunkFlag );
     if( chunkDataBytes == nullptr )
       throw mapFailed();
-    // file.read( &compressedData.front(), compressedData.size() );
+
     auto autoUnmap = qScopeGuard(
       [ & ] {
         file.unmap( chunkDataBytes );
       } );
     Q_UNUSED( autoUnmap )
 
-    unsigned long decompressedLength = chunk.size();
-
-    if( uncompress( (unsigned char *)&chunk.front(), &decompressedLength, chunkDataBytes, compressedSize ) != Z_OK
-        || decompressedLength != chunk.size() )
-    {
-      throw exFailedToDecompressChunk();
-    }
-
+    unpackChunk( chunkDataBytes, uncompressedSize, compressedSize, chunk );
   }
 
   size_t offsetInChunk = address & 0xffFF;
@@ -7,9 +7,12 @@
 #include "ex.hh"
 #include "file.hh"
 
+#include <deque>
 #include <vector>
 #include <stdint.h>
 
+#include <QFuture>
+
 /// A chunked compression storage. We use this for articles' bodies. The idea
 /// is to store data in a separately-compressed chunks, much like in dictzip,
 /// but without any fancy gzip-compatibility or whatever. Another difference
@@ -26,18 +29,52 @@ DEF_EX( exFailedToCompressChunk, "Failed to compress a chunk", Ex )
 DEF_EX( exAddressOutOfRange, "The given chunked address is out of range", Ex )
 DEF_EX( exFailedToDecompressChunk, "Failed to decompress a chunk", Ex )
 DEF_EX( mapFailed, "Failed to map/unmap the file", Ex )
+DEF_EX( exStorageFull, "The chunked storage can't address any more data", Ex )
+
+enum
+{
+  /// This is to be bumped up each time the format of the chunks changes.
+  /// The value isn't used here by itself, it is supposed to be added
+  /// to the internal format version of each dictionary which uses it.
+  FormatVersion = 1
+};
+
+enum
+{
+  ChunkMaxSize = 65536, // Can't be more since it would overflow the address
+  DefaultChunkSize = ChunkMaxSize,
+  SmallBlocksChunkSize = 16384 // For storages of many small records, such as
+                               // headword lists, which get read one at a time
+};
+
+/// A chunk compressed and ready to be written out
+struct CompressedChunk
+{
+  uint32_t uncompressedSize;
+  bool stored; // The data is kept uncompressed, as it didn't compress
+  vector< unsigned char > data;
+};
 
-/// This class writes data blocks in chunks.
+/// This class writes data blocks in chunks. The chunks are compressed in the
+/// background and written out in order.
 class Writer
 {
   vector< uint32_t > offsets;
   File::Class & file;
   size_t scratchPadOffset, scratchPadSize;
+  size_t chunkSize;
 
 public:
-  explicit Writer( File::Class & );
+  /// The chunk size is how much data gets accumulated before a chunk is
+  /// compressed. Smaller chunks are quicker to read a small block from, and
+  /// bigger ones compress better. It can't exceed ChunkMaxSize.
+  explicit Writer( File::Class &, size_t chunkSize = DefaultChunkSize );
 
-  /// Starts new block. Returns its address.
+  /// Waits for the chunks still being compressed, without writing them
+  ~Writer();
+
+  /// Starts new block. Returns its address. Throws exStorageFull if the
+  /// block can't be addressed, since there are 65536 chunks at most.
   uint32_t startNewBlock();
 
   /// Add data to the previously started block.
@@ -57,28 +94,40 @@ private:
   // stored (>=ChunkMaxSize), or there's no more data left to store.
   vector< unsigned char > buffer;
 
-  // Here we compress the chunk before writing it out to file.
-  vector< unsigned char > bufferCompressed;
-
   // The amount of data stored in buffer so far. We keep it separate
   // from buffer.size() for performance reasons; the latter one only
   // grows, but never shrinks.
   size_t bufferUsed;
 
+  // The chunks being compressed, in the order they are to be written
+  std::deque< QFuture< CompressedChunk > > pendingChunks;
+
   void saveCurrentChunk();
+
+  /// Writes out the oldest of the pending chunks
+  void writePendingChunk();
 };
 
-/// This class reads data blocks previously written by Writer.
+/// This class reads data blocks previously written by Writer. The file is
+/// mapped once, so blocks are read without any locking.
 class Reader
 {
   vector< uint32_t > offsets;
   File::Class & file;
 
+  // The whole file, or null if it couldn't be mapped. The mapping lives as
+  // long as the file does, QFile unmaps it when closed.
+  uchar const * mappedData;
+  qint64 mappedSize;
+
 public:
   /// Creates reader by giving it a file to read from and the offset returned
   /// by Writer::finish().
   Reader( File::Class &, uint32_t );
 
+  Reader( Reader const & ) = delete;
+  Reader & operator=( Reader const & ) = delete;
+
   /// Reads the block previously written by Writer, identified by its address.
   /// Uses the user-provided storage to load the entire chunk, and then to
   /// return a pointer to the requested block inside it.
@@ -4,6 +4,7 @@
 #include "file.hh"
 
 #include "zipfile.hh"
+#include "atomic_rename.hh"
 
 #include <string>
 #include <QFileInfo>
@@ -204,5 +205,34 @@ Class::~Class() noexcept
   f.close();
 }
 
+Replacement::Replacement( std::string_view filename ):
+  Class( std::string( filename ) + ".tmp", "wb" ),
+  targetName( QString::fromUtf8( filename.data(), filename.size() ) ),
+  committed( false )
+{
+}
+
+void Replacement::commit()
+{
+  if ( !file().flush() )
+    throw exWriteError();
+
+  close();
+
+  if ( !renameAtomically( targetName + ".tmp", targetName ) )
+    throw exWriteError();
+
+  committed = true;
+}
+
+Replacement::~Replacement() noexcept
+{
+  if ( !committed )
+  {
+    close();
+    QFile::remove( targetName + ".tmp" );
+  }
+}
+
 
 } // namespace File
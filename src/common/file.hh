@@ -127,6 +127,26 @@ private:
   }
 };
 
+/// Writes a file anew without touching the existing one until it's done. The
+/// data goes to a temporary file which replaces the original on commit(), so
+/// whoever has the original open or mapped keeps reading the old data. If
+/// commit() isn't reached, e.g. due to an exception, the temporary file is
+/// removed and the original stays as it was.
+class Replacement: public Class
+{
+  QString targetName;
+  bool committed;
+
+public:
+
+  explicit Replacement( std::string_view filename );
+
+  /// Closes the file and puts it in place of the original one
+  void commit();
+
+  ~Replacement() noexcept;
+};
+
 } // namespace File
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "folding.hh"
 #include <QRegularExpression>
+#include <stdint.h>
 
 #include "utf8.hh"
 #include "globalregex.hh"
@@ -20,8 +21,46 @@ bool isCombiningMark( wchar ch )
   return QChar::isMark(ch);
 }
 
+namespace {
+
+/// Returns true if the string consists of ASCII characters only. Written as
+/// a plain reduction with no early exit, so compilers vectorize it.
+bool isAscii( wstring const & in )
+{
+  wchar bits = 0;
+
+  for ( auto ch : in )
+    bits |= ch;
+
+  return bits < 0x80;
+}
+
+} // namespace
+
 wstring apply( wstring const & in, bool preserveWildcards )
 {
+  if ( isAscii( in ) ) {
+    // ASCII doesn't change under normalization and has no marks, the only
+    // whitespace to remove is the space itself. Most of the headwords get
+    // here, so it pays off to skip the QString round trip.
+    wstring caseFolded;
+
+    caseFolded.reserve( in.size() );
+
+    for ( auto const & ch : in ) {
+      if ( ch == ' ' )
+        continue;
+
+      if ( isPunct( ch )
+           && !( preserveWildcards && ( ch == '\\' || ch == '?' || ch == '*' || ch == '[' || ch == ']' ) ) )
+        continue;
+
+      caseFolded.push_back( ch >= 'A' && ch <= 'Z' ? ch + ( 'a' - 'A' ) : ch );
+    }
+
+    return caseFolded;
+  }
+
   //remove space and accent;
   auto withPunc = QString::fromStdU32String( in )
                     .normalized( QString::NormalizationForm_KD )
@@ -103,6 +142,9 @@ wstring applyFullCaseOnly( wstring const & in )
 
 wstring applyDiacriticsOnly( wstring const & in )
 {
+  if ( isAscii( in ) )
+    return in;
+
   auto noAccent = QString::fromStdU32String( in ).normalized( QString::NormalizationForm_KD ).remove( RX::accentMark );
   return noAccent.toStdU32String();
 }
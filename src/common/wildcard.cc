@@ -1,5 +1,10 @@
 #include <QRegularExpression>
 #include "wildcard.hh"
+#include "folding.hh"
+#include "utf8.hh"
+
+#include <algorithm>
+#include <string.h>
 
 /*
   Modified function from Qt
@@ -18,3 +23,199 @@ QString wildcardsToRegexp( const QString & wc_str )
 #endif
   
 }
+
+/*
+  The pattern is compiled into a nondeterministic automaton which is run
+  with the shift-and technique: each non-star element of the pattern is a
+  state, represented by a bit, and all the active states are advanced at
+  once by shifting the bit mask and masking it with the states which the
+  current character can enter. A '*' is a loop on the state preceding it.
+*/
+
+WildcardMatcher::WildcardMatcher( gd::wstring const & pattern ):
+  valid( false ),
+  states( 0 ),
+  acceptMask( 0 ),
+  starMask( 0 ),
+  anyMask( 0 )
+{
+  memset( asciiMasks, 0, sizeof( asciiMasks ) );
+
+  gd::wstring folded = Folding::applyDiacriticsOnly( Folding::applySimpleCaseOnly( pattern ) );
+
+  for( size_t x = 0; x < folded.size(); ++x )
+  {
+    gd::wchar ch = folded[ x ];
+
+    if( ch == '*' )
+    {
+      starMask |= uint64_t( 1 ) << states;
+      continue;
+    }
+
+    if( states >= 63 )
+      return; // Too long for the mask
+
+    uint64_t const bit = uint64_t( 1 ) << ( states + 1 );
+    ++states;
+
+    if( ch == '?' )
+    {
+      anyMask |= bit;
+      continue;
+    }
+
+    if( ch == '[' )
+    {
+      size_t end = x + 1;
+
+      Set set;
+      set.negated = end < folded.size() && ( folded[ end ] == '!' || folded[ end ] == '^' );
+      if( set.negated )
+        ++end;
+
+      // A ']' right after the opening bracket is a member of the set
+      size_t const first = end;
+      while( end < folded.size() && ( folded[ end ] != ']' || end == first ) )
+        ++end;
+
+      if( end < folded.size() )
+      {
+        for( size_t y = first; y < end; ++y )
+        {
+          if( y + 2 < end && folded[ y + 1 ] == '-' )
+          {
+            set.ranges.emplace_back( folded[ y ], folded[ y + 2 ] );
+            y += 2;
+          }
+          else
+            set.ranges.emplace_back( folded[ y ], folded[ y ] );
+        }
+
+        set.mask = bit;
+        sets.push_back( set );
+
+        x = end;
+        continue;
+      }
+
+      // No closing bracket, it's just a symbol then
+    }
+
+    if( ch == '\\' && x + 1 < folded.size() )
+      ch = folded[ ++x ];
+
+    if( ch < 128 )
+      asciiMasks[ ch ] |= bit;
+    else
+      literalMasks.emplace_back( ch, bit );
+  }
+
+  acceptMask = uint64_t( 1 ) << states;
+
+  // Merge the masks of the same literals so they could be binary searched
+  std::sort( literalMasks.begin(), literalMasks.end() );
+
+  size_t merged = 0;
+  for( size_t x = 0; x < literalMasks.size(); ++x )
+  {
+    if( merged && literalMasks[ merged - 1 ].first == literalMasks[ x ].first )
+      literalMasks[ merged - 1 ].second |= literalMasks[ x ].second;
+    else
+      literalMasks[ merged++ ] = literalMasks[ x ];
+  }
+  literalMasks.resize( merged );
+
+  // Everything about ASCII is resolved beforehand
+
+  for( gd::wchar ch = 0; ch < 128; ++ch )
+  {
+    if( ch != '/' )
+      asciiMasks[ ch ] |= anyMask;
+
+    for( auto const & set : sets )
+    {
+      bool inSet = false;
+      for( auto const & range : set.ranges )
+        inSet = inSet || ( ch >= range.first && ch <= range.second );
+
+      if( inSet != set.negated )
+        asciiMasks[ ch ] |= set.mask;
+    }
+  }
+
+  valid = true;
+}
+
+uint64_t WildcardMatcher::charMask( gd::wchar ch ) const
+{
+  if( ch < 128 )
+    return asciiMasks[ ch ];
+
+  uint64_t mask = anyMask;
+
+  auto literal = std::lower_bound( literalMasks.begin(),
+                                   literalMasks.end(),
+                                   std::pair< gd::wchar, uint64_t >( ch, 0 ) );
+  if( literal != literalMasks.end() && literal->first == ch )
+    mask |= literal->second;
+
+  for( auto const & set : sets )
+  {
+    bool inSet = false;
+    for( auto const & range : set.ranges )
+      inSet = inSet || ( ch >= range.first && ch <= range.second );
+
+    if( inSet != set.negated )
+      mask |= set.mask;
+  }
+
+  return mask;
+}
+
+template< typename Char >
+bool WildcardMatcher::run( Char const * word, size_t size ) const
+{
+  uint64_t active = 1; // Nothing is matched yet
+
+  if( active & acceptMask )
+    return true;
+
+  for( size_t x = 0; x < size; ++x )
+  {
+    gd::wchar ch = static_cast< gd::wchar >( word[ x ] );
+
+    // Only the utf8 fast path feeds the upper case here, the rest is folded
+    if( ch >= 'A' && ch <= 'Z' )
+      ch += 'a' - 'A';
+
+    active = ( ( active << 1 ) & charMask( ch ) ) | ( ch != '/' ? active & starMask : 0 );
+
+    if( active & acceptMask )
+      return true;
+
+    if( !active )
+      return false;
+  }
+
+  return false;
+}
+
+bool WildcardMatcher::matchesPrefixOf( gd::wstring const & word ) const
+{
+  gd::wstring folded = Folding::applySimpleCaseOnly( Folding::applyDiacriticsOnly( word ) );
+  return run( folded.data(), folded.size() );
+}
+
+bool WildcardMatcher::matchesPrefixOf( std::string const & utf8Word ) const
+{
+  unsigned char bits = 0;
+
+  for( auto ch : utf8Word )
+    bits |= static_cast< unsigned char >( ch );
+
+  if( bits < 0x80 )
+    return run( utf8Word.data(), utf8Word.size() );
+
+  return matchesPrefixOf( Utf8::decode( utf8Word ) );
+}
@@ -2,7 +2,65 @@
 #define __WILCARD_HH_INCLUDED__
 
 #include <QString>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "wstring.hh"
 
 QString wildcardsToRegexp( const QString & wc_str );
 
+/// A wildcard pattern compiled into a bit-parallel automaton, for matching
+/// many words quickly, as the btree search does. Supports '*', '?' and
+/// '[...]' sets with ranges and '!' or '^' negation; a backslash escapes the
+/// next symbol. Like the patterns made by wildcardsToRegexp(), '*' and '?'
+/// don't match '/'. Matching is case-insensitive and ignores diacritics.
+class WildcardMatcher
+{
+public:
+
+  /// Compiles the given pattern. Check isValid() before using it.
+  explicit WildcardMatcher( gd::wstring const & pattern );
+
+  /// Returns false if the pattern is too long or malformed to be compiled.
+  /// Such patterns should be handled with regular expressions instead.
+  bool isValid() const
+  { return valid; }
+
+  /// Returns true if some prefix of the given word, or the whole word,
+  /// matches the pattern, which is the way the wildcard search works.
+  bool matchesPrefixOf( gd::wstring const & word ) const;
+
+  /// Same as above, for a utf8-encoded word. Pure ASCII words, the most
+  /// common case, are matched without decoding or folding them.
+  bool matchesPrefixOf( std::string const & utf8Word ) const;
+
+private:
+
+  /// Matches a word which is already case and diacritics folded.
+  template< typename Char >
+  bool run( Char const * word, size_t size ) const;
+
+  /// Returns the mask of the states entered when the given character
+  /// follows them, already shifted.
+  uint64_t charMask( gd::wchar ch ) const;
+
+  struct Set
+  {
+    std::vector< std::pair< gd::wchar, gd::wchar > > ranges;
+    bool negated;
+    uint64_t mask;
+  };
+
+  bool valid;
+  unsigned states;           // Number of the non-star elements of the pattern
+  uint64_t acceptMask;       // The state reached when the whole pattern matched
+  uint64_t starMask;         // The states which loop on '*'
+  uint64_t anyMask;          // The states entered by '?'
+  uint64_t asciiMasks[ 128 ];
+  std::vector< std::pair< gd::wchar, uint64_t > > literalMasks; // Non-ASCII literals, sorted
+  std::vector< Set > sets;
+};
+
 #endif
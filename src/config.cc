@@ -244,6 +244,7 @@ Preferences::Preferences():
 #endif
   pronounceOnLoadMain( false ),
   pronounceOnLoadPopup( false ),
+  prefetchAudio( false ),
   useInternalPlayer( InternalPlayerBackend::anyAvailable() ),
   internalPlayerBackend( InternalPlayerBackend::defaultBackend() ),
   checkForNewReleases( true ),
@@ -932,6 +933,7 @@ Class load()
 
     c.preferences.pronounceOnLoadMain = ( preferences.namedItem( "pronounceOnLoadMain" ).toElement().text() == "1" );
     c.preferences.pronounceOnLoadPopup = ( preferences.namedItem( "pronounceOnLoadPopup" ).toElement().text() == "1" );
+    c.preferences.prefetchAudio = ( preferences.namedItem( "prefetchAudio" ).toElement().text() == "1" );
 
     if ( InternalPlayerBackend::anyAvailable() )
     {
@@ -1849,6 +1851,10 @@ void save( Class const & c )
     opt.appendChild( dd.createTextNode( c.preferences.pronounceOnLoadPopup ? "1" : "0" ) );
     preferences.appendChild( opt );
 
+    opt = dd.createElement( "prefetchAudio" );
+    opt.appendChild( dd.createTextNode( c.preferences.prefetchAudio ? "1" : "0" ) );
+    preferences.appendChild( opt );
+
     opt = dd.createElement( "useInternalPlayer" );
     opt.appendChild( dd.createTextNode( c.preferences.useInternalPlayer ? "1" : "0" ) );
     preferences.appendChild( opt );
@@ -2281,6 +2287,14 @@ QString getProgramDataDir() noexcept
   #endif
 }
 
+QString getSharedIndexDir() noexcept
+{
+  if ( QDir( getProgramDataDir() ).cd( "shared_index" ) )
+    return getProgramDataDir() + "/shared_index";
+  else
+    return QString();
+}
+
 QString getLocDir() noexcept
 {
   if ( QDir( getProgramDataDir() ).cd( "locale" ) )
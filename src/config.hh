@@ -298,6 +298,9 @@ struct Preferences
 
   // Whether the word should be pronounced on page load, in main window/popup
   bool pronounceOnLoadMain, pronounceOnLoadPopup;
+  // Whether the first audio links of a displayed article should be fetched
+  // in the background, so that clicking them plays without a delay
+  bool prefetchAudio;
   bool useInternalPlayer;
   InternalPlayerBackend internalPlayerBackend;
   QString audioPlaybackProgram;
@@ -796,6 +799,11 @@ QString getConfigDir() ;
 /// Returns the index directory, where the indices are to be stored.
 QString getIndexDir() ;
 
+/// Returns the shared index directory, or an empty string if there's none.
+/// It is a read-only directory deployed along with the program, holding
+/// indices made elsewhere, which get reused for identical dictionaries.
+QString getSharedIndexDir() noexcept;
+
 /// Returns the filename of a .pid file which should store current pid of
 /// the process.
 QString getPidFileName() ;
@@ -2,6 +2,9 @@
 #include "zlib.h"
 #include "bzlib.h"
 
+#include <algorithm>
+#include <cstring>
+
 #ifdef MAKE_ZIM_SUPPORT
 #include "lzma.h"
 #include "zstd.h"
@@ -9,88 +12,221 @@
 
 #define CHUNK_SIZE 2048
 
-QByteArray zlibDecompress( const char * bufptr, unsigned length )
+namespace {
+
+/// The hint comes from the files, which may be corrupt, so it is only
+/// trusted as far as deflate could expand the input, and up to this size.
+/// Past that, the output grows as the data actually decompresses.
+size_t const MaxTrustedHint = 64 * 1024 * 1024;
+size_t const MaxDeflateRatio = 1032;
+
+/// The size the output buffer starts with
+size_t initialOutputSize( unsigned length, size_t sizeHint )
 {
-z_stream zs;
-char buf[CHUNK_SIZE];
-QByteArray str;
-int res;
-    memset( &zs, 0, sizeof(zs) );
-    zs.next_in = (Bytef *)bufptr;
-    zs.avail_in = length;
-    while( 1 )
-    {
-        res = inflateInit( &zs );
-        if( res != Z_OK )
-            break;
-        while( res != Z_STREAM_END )
-        {
-            zs.next_out = (Bytef *)buf;
-            zs.avail_out = CHUNK_SIZE;
-            res = inflate( &zs, Z_SYNC_FLUSH );
-            str.append( buf, CHUNK_SIZE - zs.avail_out );
-            if( res != Z_OK && res != Z_STREAM_END )
-                 break;
-        }
-        break;
-    }
-    inflateEnd( &zs );
-    if( res != Z_STREAM_END )
-        str.clear();
-    return str;
+  size_t const guess = std::max< size_t >( CHUNK_SIZE, (size_t)length * 4 );
+
+  if( !sizeHint )
+    return guess;
+
+  size_t const bound = std::min( MaxTrustedHint, std::max< size_t >( CHUNK_SIZE, (size_t)length * MaxDeflateRatio ) );
+
+  return sizeHint <= bound ? sizeHint : std::max( guess, bound );
+}
+
+/// Makes sure there's free space in the output past the used bytes
+template< typename Container >
+void growOutput( Container & out, size_t used )
+{
+  if( used >= (size_t)out.size() )
+    out.resize( std::max< size_t >( used * 2, CHUNK_SIZE ) );
+}
+
+/// A zlib stream which lives as long as its thread. It is reset between
+/// uses instead of being set up anew for every block.
+class ZlibInflater
+{
+  z_stream zs;
+  bool initialized = false;
+
+public:
+
+  ~ZlibInflater()
+  {
+    if( initialized )
+      inflateEnd( &zs );
+  }
+
+  z_stream * stream()
+  {
+    if( initialized )
+      return inflateReset( &zs ) == Z_OK ? &zs : nullptr;
+
+    memset( &zs, 0, sizeof( zs ) );
+
+    if( inflateInit( &zs ) != Z_OK )
+      return nullptr;
+
+    initialized = true;
+    return &zs;
+  }
+};
+
+template< typename Container >
+bool zlibInflate( const char * bufptr, unsigned length, size_t sizeHint, Container & out )
+{
+  thread_local ZlibInflater inflater;
+
+  z_stream * zs = inflater.stream();
+  if( !zs )
+    return false;
+
+  zs->next_in = (Bytef *)bufptr;
+  zs->avail_in = length;
+
+  size_t used = 0;
+  out.resize( initialOutputSize( length, sizeHint ) );
+
+  for( ;; )
+  {
+    growOutput( out, used );
+
+    zs->next_out = (Bytef *)out.data() + used;
+    zs->avail_out = out.size() - used;
+
+    int res = inflate( zs, Z_SYNC_FLUSH );
+
+    used = out.size() - zs->avail_out;
+
+    if( res == Z_STREAM_END )
+      break;
+
+    if( res != Z_OK )
+      return false;
+  }
+
+  out.resize( used );
+  return true;
+}
+
+} // namespace
+
+QByteArray zlibDecompress( const char * bufptr, unsigned length, size_t sizeHint )
+{
+  QByteArray str;
+
+  if( !zlibInflate( bufptr, length, sizeHint, str ) )
+    str.clear();
+
+  return str;
 }
 
-string decompressZlib( const char * bufptr, unsigned length )
+string decompressZlib( const char * bufptr, unsigned length, size_t sizeHint )
 {
-  QByteArray b = zlibDecompress( bufptr, length );
-  return string( b.constData(), b.size() );
+  string str;
+
+  if( !zlibInflate( bufptr, length, sizeHint, str ) )
+    str.clear();
+
+  return str;
 }
 
-string decompressBzip2( const char * bufptr, unsigned length )
+string decompressBzip2( const char * bufptr, unsigned length, size_t sizeHint )
 {
-bz_stream zs;
-char buf[CHUNK_SIZE];
-string str;
-int res;
-    memset( &zs, 0, sizeof(zs) );
-    zs.next_in = (char *)bufptr;
-    zs.avail_in = length;
-    zs.total_in_lo32 = length;
-    while( 1 )
-    {
-        res = BZ2_bzDecompressInit( &zs, 0, 0 );
-        if( res != BZ_OK )
-            break;
-        while( res != BZ_STREAM_END )
-        {
-            zs.next_out = buf;
-            zs.avail_out = CHUNK_SIZE;
-            zs.total_out_lo32 = length;
-            res = BZ2_bzDecompress( &zs );
-            str.append( buf, CHUNK_SIZE - zs.avail_out );
-            if( res != BZ_OK && res != BZ_STREAM_END )
-                break;
-        }
-        break;
-    }
-    BZ2_bzDecompressEnd( &zs );
-    if( res != BZ_STREAM_END )
-        str.clear();
+  // libbz2 has no way to reset a stream, so it is set up for every call
+
+  bz_stream zs;
+  string str;
+  int res;
+
+  memset( &zs, 0, sizeof( zs ) );
+
+  if( BZ2_bzDecompressInit( &zs, 0, 0 ) != BZ_OK )
     return str;
+
+  zs.next_in = (char *)bufptr;
+  zs.avail_in = length;
+
+  size_t used = 0;
+  str.resize( initialOutputSize( length, sizeHint ) );
+
+  do
+  {
+    growOutput( str, used );
+
+    zs.next_out = str.data() + used;
+    zs.avail_out = str.size() - used;
+
+    res = BZ2_bzDecompress( &zs );
+
+    used = str.size() - zs.avail_out;
+
+    // All the input is consumed, yet the stream isn't over: it's truncated
+    if( res == BZ_OK && zs.avail_in == 0 && zs.avail_out != 0 )
+      res = BZ_UNEXPECTED_EOF;
+  }
+  while( res == BZ_OK );
+
+  BZ2_bzDecompressEnd( &zs );
+
+  if( res != BZ_STREAM_END )
+    str.clear();
+  else
+    str.resize( used );
+
+  return str;
 }
 
 #ifdef MAKE_ZIM_SUPPORT
 
+namespace {
+
+/// An lzma stream which lives as long as its thread. liblzma reuses the
+/// memory of an initialized stream when it is initialized again.
+class LzmaDecoder
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+
+public:
+
+  ~LzmaDecoder()
+  { lzma_end( &strm ); }
+
+  lzma_stream * stream()
+  { return &strm; }
+};
+
+/// A zstd context which lives as long as its thread
+class ZstdDecoder
+{
+  ZSTD_DCtx * dctx = nullptr;
+
+public:
+
+  ~ZstdDecoder()
+  { ZSTD_freeDCtx( dctx ); }
+
+  ZSTD_DCtx * context()
+  {
+    if( !dctx )
+      dctx = ZSTD_createDCtx();
+    else
+      ZSTD_DCtx_reset( dctx, ZSTD_reset_session_only );
+
+    return dctx;
+  }
+};
+
+} // namespace
+
 string decompressLzma2( const char * bufptr, unsigned length,
-                        bool raw_decoder )
+                        bool raw_decoder, size_t sizeHint )
 {
-string str;
-lzma_ret res;
-char buf[CHUNK_SIZE];
+  thread_local LzmaDecoder decoder;
 
-  lzma_stream strm = LZMA_STREAM_INIT;
-  strm.next_in = reinterpret_cast< const uint8_t * >( bufptr );
-  strm.avail_in = length;
+  string str;
+  lzma_ret res;
+
+  lzma_stream * strm = decoder.stream();
 
   lzma_options_lzma opt;
   lzma_filter filters[ 2 ];
@@ -102,74 +238,85 @@ char buf[CHUNK_SIZE];
     filters[ 0 ].id = LZMA_FILTER_LZMA2;
     filters[ 0 ].options = &opt;
     filters[ 1 ].id = LZMA_VLI_UNKNOWN;
+
+    res = lzma_raw_decoder( strm, filters );
   }
+  else
+    res = lzma_stream_decoder( strm, UINT64_MAX, 0 );
+
+  if( res != LZMA_OK )
+    return str;
+
+  strm->next_in = reinterpret_cast< const uint8_t * >( bufptr );
+  strm->avail_in = length;
 
-  while( 1 )
+  size_t used = 0;
+  str.resize( initialOutputSize( length, sizeHint ) );
+
+  do
   {
-    if( raw_decoder )
-      res = lzma_raw_decoder( &strm, filters );
-    else
-      res = lzma_stream_decoder( &strm, UINT64_MAX, 0 );
+    growOutput( str, used );
 
-    if( res != LZMA_OK )
-      break;
+    strm->next_out = reinterpret_cast< uint8_t * >( str.data() ) + used;
+    strm->avail_out = str.size() - used;
 
-    while ( res != LZMA_STREAM_END )
-    {
-      strm.next_out = reinterpret_cast< uint8_t * >( buf );
-      strm.avail_out = CHUNK_SIZE;
-      res = lzma_code( &strm, LZMA_RUN );
-      str.append( buf, CHUNK_SIZE - strm.avail_out );
-      if( res != LZMA_OK && res != LZMA_STREAM_END )
-        break;
-    }
-    lzma_end( &strm );
-    if( res != LZMA_STREAM_END )
-      str.clear();
-
-    break;
+    res = lzma_code( strm, LZMA_RUN );
+
+    used = str.size() - strm->avail_out;
   }
+  while( res == LZMA_OK );
+
+  if( res != LZMA_STREAM_END )
+    str.clear();
+  else
+    str.resize( used );
+
   return str;
 }
 
-string decompressZstd( const char *bufptr, unsigned length )
+string decompressZstd( const char * bufptr, unsigned length, size_t sizeHint )
 {
+  thread_local ZstdDecoder decoder;
+
   string str;
-  char buf[CHUNK_SIZE];
-  size_t res;
-//  string err;
-  ZSTD_DStream *zds;
-  ZSTD_inBuffer in_buf = { bufptr, length, 0 };
-  ZSTD_outBuffer out_buf = { buf, CHUNK_SIZE, 0 };
 
-  zds = ZSTD_createDStream();
-  if( !zds )
+  ZSTD_DCtx * dctx = decoder.context();
+  if( !dctx )
     return str;
 
-  res = ZSTD_initDStream( zds );
-  if( ZSTD_isError( res ) )
+  if( !sizeHint )
   {
-//    err = string( ZSTD_getErrorName( res ) );
-    ZSTD_freeDStream( zds );
-    return str;
+    // The frame header usually tells the size
+    unsigned long long frameSize = ZSTD_getFrameContentSize( bufptr, length );
+
+    if( frameSize != ZSTD_CONTENTSIZE_UNKNOWN && frameSize != ZSTD_CONTENTSIZE_ERROR )
+      sizeHint = frameSize;
   }
 
-  do
+  ZSTD_inBuffer in_buf = { bufptr, length, 0 };
+
+  size_t used = 0;
+  str.resize( initialOutputSize( length, sizeHint ) );
+
+  for( ;; )
   {
-    out_buf.pos = 0;
-    res = ZSTD_decompressStream( zds, &out_buf, &in_buf );
+    growOutput( str, used );
+
+    ZSTD_outBuffer out_buf = { str.data(), str.size(), used };
+
+    size_t res = ZSTD_decompressStream( dctx, &out_buf, &in_buf );
+
+    used = out_buf.pos;
+
     if( ZSTD_isError( res ) )
-    {
-//      err = string( ZSTD_getErrorName( res ) );
-      ZSTD_freeDStream( zds );
       return string();
-    }
 
-    str.append( buf, out_buf.pos );
+    // Done once all the input is consumed and everything is flushed
+    if( in_buf.pos >= in_buf.size && out_buf.pos < out_buf.size )
+      break;
   }
-  while( out_buf.pos >= out_buf.size );
 
-  ZSTD_freeDStream( zds );
+  str.resize( used );
 
   return str;
 }
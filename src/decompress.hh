@@ -6,18 +6,24 @@
 
 using std::string;
 
-QByteArray zlibDecompress( const char * bufptr, unsigned length );
+/// All the functions below return an empty result on failure. The sizeHint,
+/// when known, is the expected size of the decompressed data: the output is
+/// then allocated once and decompressed into directly. A hint too large for
+/// the input to expand to is only partly trusted, the output grows instead. The codec contexts
+/// are kept per thread and reused between calls where the codec allows that.
 
-string decompressZlib( const char * bufptr, unsigned length );
+QByteArray zlibDecompress( const char * bufptr, unsigned length, size_t sizeHint = 0 );
 
-string decompressBzip2( const char * bufptr, unsigned length );
+string decompressZlib( const char * bufptr, unsigned length, size_t sizeHint = 0 );
+
+string decompressBzip2( const char * bufptr, unsigned length, size_t sizeHint = 0 );
 
 #ifdef MAKE_ZIM_SUPPORT
 
 string decompressLzma2( const char * bufptr, unsigned length,
-                        bool raw_decoder = false );
+                        bool raw_decoder = false, size_t sizeHint = 0 );
 
-string decompressZstd( const char * bufptr, unsigned length );
+string decompressZstd( const char * bufptr, unsigned length, size_t sizeHint = 0 );
 
 #endif
 
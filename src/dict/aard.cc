@@ -97,7 +97,7 @@ __attribute__((packed))
 enum
 {
   Signature = 0x58524141, // AARX on little-endian, XRAA on big-endian
-  CurrentFormatVersion = 4 + BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 4 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 struct IdxHeader
@@ -820,6 +820,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         try
         {
 
@@ -904,7 +907,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
           initializing.indexingDictionary( dictName );
 
-          File::Class idx( indexFile, "wb" );
+          File::Replacement idx( indexFile );
           IdxHeader idxHeader;
           memset( &idxHeader, 0, sizeof( idxHeader ) );
 
@@ -1012,6 +1015,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           idx.rewind();
 
           idx.write( &idxHeader, sizeof( idxHeader ) );
+          idx.commit();
+          Dictionary::indexBuilt( dictFiles, indexFile );
         }
         catch( std::exception & e )
         {
@@ -15,6 +15,7 @@
 #include "utf8.hh"
 #include "utils.hh"
 
+#include <algorithm>
 #include <ctype.h>
 #include <list>
 #include <map>
@@ -58,7 +59,7 @@ namespace
   enum
   {
     Signature = 0x584c4742, // BGLX on little-endian, XLGB on big-endian
-    CurrentFormatVersion = 19 + BtreeIndexing::FormatVersion
+    CurrentFormatVersion = 20 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion
   };
 
   struct IdxHeader
@@ -77,7 +78,8 @@ namespace
     uint32_t chunksOffset; // The offset to chunks' storage
     uint32_t indexBtreeMaxElements; // Two fields from IndexInfo
     uint32_t indexRootOffset;
-    uint32_t resourceListOffset; // The offset of the list of resources
+    uint32_t resourceListOffset; // The offset of the list of resources, sorted
+                                 // by their lowercased names
     uint32_t resourcesCount; // Number of resources stored
     uint32_t langFrom;  // Source language
     uint32_t langTo;    // Target language
@@ -189,6 +191,12 @@ namespace
     IdxHeader idxHeader;
     ChunkedStorage::Reader chunks;
 
+    /// The list of resources: lowercased names, sorted, with the offsets of
+    /// the resources. Loaded on the first resource request.
+    vector< pair< string, uint32_t > > resources;
+    QMutex resourcesMutex;
+    bool resourcesLoaded = false;
+
   public:
 
     BglDictionary( string const & id, string const & indexFile,
@@ -249,6 +257,10 @@ namespace
 
     static void replaceCharsetEntities( string & );
 
+    /// Looks up the resource with the given lowercased name. Returns false if
+    /// there's no such resource.
+    bool findResource( string const & nameLowercased, uint32_t & offset );
+
     friend class BglHeadwordsRequest;
     friend class BglArticleRequest;
     friend class BglResourceRequest;
@@ -863,12 +875,50 @@ sptr< Dictionary::DataRequest > BglDictionary::getArticle( wstring const & word,
 
 //// BglDictionary::getResource()
 
+bool BglDictionary::findResource( string const & nameLowercased, uint32_t & offset )
+{
+  QMutexLocker _( &resourcesMutex );
+
+  if ( !resourcesLoaded )
+  {
+    resources.clear();
+    resources.reserve( idxHeader.resourcesCount );
+
+    QMutexLocker _( &idxMutex );
+
+    idx.seek( idxHeader.resourceListOffset );
+
+    for( size_t count = idxHeader.resourcesCount; count--; )
+    {
+      string resourceName( idx.read< uint32_t >(), '\0' );
+      idx.read( &resourceName[ 0 ], resourceName.size() );
+
+      uint32_t resourceOffset = idx.read< uint32_t >();
+
+      resources.emplace_back( std::move( resourceName ), resourceOffset );
+    }
+
+    resourcesLoaded = true;
+  }
+
+  vector< pair< string, uint32_t > >::const_iterator i =
+    std::lower_bound( resources.cbegin(), resources.cend(), nameLowercased,
+                      []( pair< string, uint32_t > const & resource, string const & name ) {
+                        return resource.first < name;
+                      } );
+
+  if ( i == resources.cend() || i->first != nameLowercased )
+    return false;
+
+  offset = i->second;
+
+  return true;
+}
+
 class BglResourceRequest: public Dictionary::DataRequest
 {
 
-  QMutex & idxMutex;
-  File::Class & idx;
-  uint32_t resourceListOffset, resourcesCount;
+  BglDictionary & dict;
   string name;
 
   QAtomicInt isCancelled;
@@ -876,15 +926,9 @@ class BglResourceRequest: public Dictionary::DataRequest
 
 public:
 
-  BglResourceRequest( QMutex & idxMutex_,
-                      File::Class & idx_,
-                      uint32_t resourceListOffset_,
-                      uint32_t resourcesCount_,
+  BglResourceRequest( BglDictionary & dict_,
                       string const & name_ ):
-    idxMutex( idxMutex_ ),
-    idx( idx_ ),
-    resourceListOffset( resourceListOffset_ ),
-    resourcesCount( resourcesCount_ ),
+    dict( dict_ ),
     name( name_ )
   {
     f = QtConcurrent::run( [ this ]() {
@@ -920,53 +964,52 @@ void BglResourceRequest::run()
        ++i )
     *i = tolower( *i );
 
-  QMutexLocker _( &idxMutex );
-
-  idx.seek( resourceListOffset );
-
-  for( size_t count = resourcesCount; count--; )
+  try
   {
-    if ( Utils::AtomicInt::loadAcquire( isCancelled ) )
-      break;
-
-    vector< char > nameData( idx.read< uint32_t >() );
-    idx.read( &nameData.front(), nameData.size() );
-
-    for( size_t x = nameData.size(); x--; )
-      nameData[ x ] = tolower( nameData[ x ] );
+    uint32_t offset;
 
-    uint32_t offset = idx.read< uint32_t >();
-
-    if ( string( &nameData.front(), nameData.size() ) == nameLowercased )
+    if ( dict.findResource( nameLowercased, offset ) )
     {
-      // We have a match.
+      vector< unsigned char > compressedData;
+      unsigned long decompressedLength;
 
-      idx.seek( offset );
+      {
+        QMutexLocker _( &dict.idxMutex );
 
-      QMutexLocker _( &dataMutex );
+        dict.idx.seek( offset );
 
-      data.resize( idx.read< uint32_t >() );
+        decompressedLength = dict.idx.read< uint32_t >();
 
-      vector< unsigned char > compressedData( idx.read< uint32_t >() );
+        compressedData.resize( dict.idx.read< uint32_t >() );
+
+        dict.idx.read( compressedData.data(), compressedData.size() );
+      }
 
-      idx.read( &compressedData.front(), compressedData.size() );
+      // The index is not needed to decompress
 
-      unsigned long decompressedLength = data.size();
+      vector< char > resourceData( decompressedLength );
 
-      if ( uncompress( (unsigned char *) &data.front(),
+      if ( uncompress( (unsigned char *) resourceData.data(),
                        &decompressedLength,
-                       &compressedData.front(),
+                       compressedData.data(),
                        compressedData.size() ) != Z_OK ||
-           decompressedLength != data.size() )
+           decompressedLength != resourceData.size() )
       {
         gdWarning( "Failed to decompress resource \"%s\", ignoring it.\n", name.c_str() );
       }
       else
-        hasAnyData = true;
+      {
+        QMutexLocker _( &dataMutex );
 
-      break;
+        data.swap( resourceData );
+        hasAnyData = true;
+      }
     }
   }
+  catch( std::exception & e )
+  {
+    setErrorString( QString::fromUtf8( e.what() ) );
+  }
 
   finish();
 }
@@ -974,8 +1017,7 @@ void BglResourceRequest::run()
 sptr< Dictionary::DataRequest > BglDictionary::getResource( string const & name )
   
 {
-  return std::shared_ptr<BglResourceRequest>(new BglResourceRequest(idxMutex, idx, idxHeader.resourceListOffset,
-                                 idxHeader.resourcesCount, name ));
+  return std::make_shared< BglResourceRequest >( *this, name );
 }
 
   /// Replaces <CHARSET c="t">1234;</CHARSET> occurrences with &#x1234;
@@ -1100,6 +1142,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
     if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
          indexIsOldOrBad( indexFile ) )
     {
+      if ( initializing.isIndexingDeferred( dictFiles ) )
+        continue; // It will be built in the background
+
       // Building the index
 
       gdDebug( "Bgl: Building the index for dictionary: %s\n", i->c_str() );
@@ -1121,7 +1166,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
         initializing.indexingDictionary( b.title() );
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
 
         IdxHeader idxHeader;
 
@@ -1216,14 +1261,28 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idxHeader.indexBtreeMaxElements = idxInfo.btreeMaxElements;
         idxHeader.indexRootOffset = idxInfo.rootOffset;
 
-        // Save the resource's list.
+        // Save the resource's list. The names are lowercased and sorted, so
+        // that the resources can be looked up with a binary search.
+
+        vector< pair< string, uint32_t > > resources( resourceHandler.getResources().begin(),
+                                                      resourceHandler.getResources().end() );
+
+        for( vector< pair< string, uint32_t > >::iterator j = resources.begin();
+             j != resources.end(); ++j )
+          for( string::iterator k = j->first.begin(); k != j->first.end(); ++k )
+            *k = tolower( *k );
+
+        // Stable, so that the first of the same-named resources is found
+        std::stable_sort( resources.begin(), resources.end(),
+                          []( pair< string, uint32_t > const & a, pair< string, uint32_t > const & b ) {
+                            return a.first < b.first;
+                          } );
 
         idxHeader.resourceListOffset = idx.tell();
-        idxHeader.resourcesCount = resourceHandler.getResources().size();
+        idxHeader.resourcesCount = resources.size();
 
-        for( list< pair< string, uint32_t > >::const_iterator j =
-            resourceHandler.getResources().begin();
-             j != resourceHandler.getResources().end(); ++j )
+        for( vector< pair< string, uint32_t > >::const_iterator j = resources.begin();
+             j != resources.end(); ++j )
         {
           idx.write< uint32_t >( j->first.size() );
           idx.write( j->first.data(), j->first.size() );
@@ -1244,6 +1303,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.rewind();
 
         idx.write( &idxHeader, sizeof( idxHeader ) );
+        idx.commit();
+        Dictionary::indexBuilt( dictFiles, indexFile );
       }
       catch( std::exception & e )
       {
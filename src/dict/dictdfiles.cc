@@ -616,6 +616,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         // Building the index
         string dictionaryName = nameFromFileName( dictFiles[ 0 ] );
 
@@ -623,7 +626,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
         initializing.indexingDictionary( dictionaryName );
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
 
         IdxHeader idxHeader;
 
@@ -766,6 +769,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.rewind();
 
         idx.write( &idxHeader, sizeof( idxHeader ) );
+        idx.commit();
+        Dictionary::indexBuilt( dictFiles, indexFile );
       }
 
       dictionaries.push_back( std::make_shared<DictdDictionary>( dictId,
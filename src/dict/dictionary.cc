@@ -20,8 +20,15 @@
 #include <QImage>
 #include <QPainter>
 #include <QRegularExpression>
+#include <QFile>
+#include <QMultiHash>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtEndian>
 #include "utils.hh"
 #include "zipfile.hh"
+#include "atomic_rename.hh"
 
 namespace Dictionary {
 
@@ -551,50 +558,645 @@ string makeDictionaryId( vector< string > const & dictionaryFiles ) noexcept
   return hash.result().toHex().data();
 }
 
-// While this file is not supposed to have any Qt stuff since it's used by
-// the dictionary backends, there's no platform-independent way to get hold
-// of a timestamp of the file, so we use here Qt anyway. It is supposed to
-// be fixed in the future when it's needed.
-bool needToRebuildIndex( vector< string > const & dictionaryFiles,
-                         string const & indexFile ) noexcept
+namespace {
+
+/// How many blocks of each dictionary file go into its sample fingerprint,
+/// and their size. Files smaller than all the blocks together are hashed whole.
+enum
+{
+  FingerprintBlocks = 16,
+  FingerprintBlockSize = 4096
+};
+
+/// A dictionary file as last seen, to tell whether it was touched since
+/// without reading it
+struct FileStamp
+{
+  QString name;
+  qint64 size;
+  qint64 modified; // Msecs since epoch
+
+  bool operator==( FileStamp const & other ) const
+  { return size == other.size && modified == other.modified && name == other.name; }
+};
+
+/// Lists the actual files of the given dictionary files, i.e. the parts of
+/// the split zips, and skips the directories. Returns false if some files
+/// don't exist.
+bool stampDictionaryFiles( vector< string > const & dictionaryFiles,
+                           vector< FileStamp > & stamps )
 {
-  unsigned long lastModified = 0;
+  vector< string > names;
 
   for( std::vector< string >::const_iterator i = dictionaryFiles.begin();
        i != dictionaryFiles.end(); ++i )
   {
     QString name = QString::fromUtf8( i->c_str() );
-    QFileInfo fileInfo( name );
-    unsigned long ts;
 
-    if( fileInfo.isDir() )
+    if( QFileInfo( name ).isDir() )
       continue;
 
     if( name.toLower().endsWith( ".zip" ) )
     {
       ZipFile::SplitZipFile zf( name );
       if( !zf.exists() )
-        return true;
-      ts = zf.lastModified().toSecsSinceEpoch();
+        return false;
+
+      zf.getFilenames( names );
     }
     else
+      names.push_back( *i );
+  }
+
+  stamps.clear();
+
+  for( vector< string >::const_iterator i = names.begin(); i != names.end(); ++i )
+  {
+    QFileInfo fileInfo( QString::fromUtf8( i->c_str() ) );
+
+    if ( !fileInfo.isFile() )
+      return false;
+
+    stamps.push_back( { fileInfo.filePath(), fileInfo.size(),
+                        fileInfo.lastModified().toMSecsSinceEpoch() } );
+  }
+
+  return true;
+}
+
+/// Adds the name, the size and the contents of the given file to the hash.
+/// Unless whole is true, only a sample of the blocks of the contents goes
+/// there. The first and the last blocks are always sampled, since that's
+/// where most formats keep their headers and indices. Returns false if the
+/// file can't be read, or if 'stopped' got set meanwhile.
+bool addFileFingerprint( QString const & name, QCryptographicHash & hash, bool whole,
+                         QAtomicInt const * stopped )
+{
+  QFile file( name );
+
+  if ( !file.open( QFile::ReadOnly ) )
+    return false;
+
+  // The name goes without the path, so the dictionary may be moved around
+  QByteArray fileName = QFileInfo( name ).fileName().toUtf8();
+  hash.addData( fileName.data(), fileName.size() + 1 );
+
+  qint64 size = file.size();
+  quint64 sizeLe = qToLittleEndian( (quint64)size );
+  hash.addData( (char const *)&sizeLe, sizeof( sizeLe ) );
+
+  QByteArray block( FingerprintBlockSize, 0 );
+
+  if ( whole || size <= FingerprintBlocks * FingerprintBlockSize )
+  {
+    for ( ; ; )
+    {
+      if ( stopped && Utils::AtomicInt::loadAcquire( *stopped ) )
+        return false;
+
+      qint64 got = file.read( block.data(), block.size() );
+
+      if ( got <= 0 )
+        return got == 0;
+
+      hash.addData( block.data(), got );
+    }
+  }
+
+  qint64 step = ( size - FingerprintBlockSize ) / ( FingerprintBlocks - 1 );
+
+  for ( int x = 0; x < FingerprintBlocks; ++x )
+  {
+    if ( !file.seek( x * step ) || file.read( block.data(), block.size() ) != block.size() )
+      return false;
+
+    hash.addData( block.data(), block.size() );
+  }
+
+  return true;
+}
+
+/// Makes a fingerprint of the contents of the given files, either of the
+/// samples of them or of them whole. Returns false if some can't be read.
+bool makeContentFingerprint( vector< FileStamp > const & files, bool whole,
+                             QByteArray & fingerprint, QAtomicInt const * stopped = nullptr )
+{
+  QCryptographicHash hash( QCryptographicHash::Md5 );
+
+  for( vector< FileStamp >::const_iterator i = files.begin(); i != files.end(); ++i )
+    if( !addFileFingerprint( i->name, hash, whole, stopped ) )
+      return false;
+
+  fingerprint = hash.result().toHex();
+
+  return true;
+}
+
+/// The fingerprints of the dictionary files. The whole-content one is only
+/// made when asked for, since it takes reading the files in full, while
+/// the sampled one is only good to tell which indices are worth a look.
+class DictionaryContents
+{
+  vector< FileStamp > const & files;
+  QByteArray sample, whole;
+
+public:
+
+  explicit DictionaryContents( vector< FileStamp > const & files_ ):
+    files( files_ )
+  {}
+
+  vector< FileStamp > const & getFiles() const
+  { return files; }
+
+  /// Both return false if some files can't be read
+  bool getSample( QByteArray & );
+  bool getWhole( QByteArray & );
+};
+
+bool DictionaryContents::getSample( QByteArray & result )
+{
+  if ( sample.isEmpty() && !makeContentFingerprint( files, false, sample ) )
+    return false;
+
+  result = sample;
+  return true;
+}
+
+bool DictionaryContents::getWhole( QByteArray & result )
+{
+  if ( whole.isEmpty() && !makeContentFingerprint( files, true, whole ) )
+    return false;
+
+  result = whole;
+  return true;
+}
+
+/// The manifest of an index. It is kept next to the index file and tells
+/// which contents of the dictionary files the index was built from, along
+/// with how the files looked then, so the contents need no reading while
+/// the files stay untouched.
+struct IndexManifest
+{
+  QByteArray sample; // Fingerprint of the sampled contents
+  /// Fingerprint of the whole contents. It is made in background, so it may
+  /// be empty for a while.
+  QByteArray whole;
+  /// The index file the manifest was written for
+  qint64 indexSize = -1;
+  qint64 indexModified = -1; // Msecs since epoch
+  vector< FileStamp > files;
+
+  bool read( QString const & indexFile );
+  bool write( QString const & indexFile );
+
+  /// Returns true if the manifest may have been written for the given index
+  /// file. Only the size is compared, since the index may have been copied
+  /// along with the dictionaries, without its time.
+  bool fits( QFileInfo const & indexInfo ) const
+  { return indexSize == indexInfo.size(); }
+};
+
+QString manifestFileName( QString const & indexFile )
+{
+  return indexFile + ".manifest";
+}
+
+/// The manifest is a text file. Its first line holds the fingerprints and
+/// the index size and time, the other ones the size, the time and the name
+/// of each dictionary file.
+bool IndexManifest::read( QString const & indexFile )
+{
+  QFile file( manifestFileName( indexFile ) );
+
+  if ( !file.open( QFile::ReadOnly ) )
+    return false;
+
+  QList< QByteArray > lines = file.readAll().split( '\n' );
+
+  QList< QByteArray > fields = lines.value( 0 ).split( ' ' );
+
+  // The manifests written before the whole contents were fingerprinted have
+  // three fields. These are dropped, so the index gets checked anew.
+  if ( fields.size() != 4 )
+    return false;
+
+  sample = fields[ 0 ];
+  whole = fields[ 1 ] == "-" ? QByteArray() : fields[ 1 ];
+  indexSize = fields[ 2 ].toLongLong();
+  indexModified = fields[ 3 ].toLongLong();
+
+  files.clear();
+
+  for ( int x = 1; x < lines.size(); ++x )
+  {
+    if ( lines[ x ].isEmpty() )
+      continue;
+
+    QList< QByteArray > stamp = lines[ x ].split( ' ' );
+
+    if ( stamp.size() < 3 )
+      return false;
+
+    // The name may have spaces, so it takes the rest of the line
+    int nameOffset = stamp[ 0 ].size() + stamp[ 1 ].size() + 2;
+
+    files.push_back( { QString::fromUtf8( lines[ x ].mid( nameOffset ) ),
+                       stamp[ 0 ].toLongLong(), stamp[ 1 ].toLongLong() } );
+  }
+
+  return true;
+}
+
+bool IndexManifest::write( QString const & indexFile )
+{
+  QFileInfo indexInfo( indexFile );
+
+  indexSize = indexInfo.size();
+  indexModified = indexInfo.lastModified().toMSecsSinceEpoch();
+
+  QByteArray data = sample + ' ' + ( whole.isEmpty() ? QByteArray( "-" ) : whole ) + ' '
+                    + QByteArray::number( indexSize ) + ' ' + QByteArray::number( indexModified ) + '\n';
+
+  for ( FileStamp const & stamp : files )
+    data += QByteArray::number( stamp.size ) + ' ' + QByteArray::number( stamp.modified ) + ' '
+            + stamp.name.toUtf8() + '\n';
+
+  // The manifest is also written from the background, so it must never be
+  // seen half-written
+  QString tmpName = manifestFileName( indexFile ) + ".tmp";
+  QFile file( tmpName );
+
+  if ( !file.open( QFile::WriteOnly | QFile::Truncate ) )
+    return false;
+
+  bool written = file.write( data ) == data.size();
+  file.close();
+
+  if ( !written || !renameAtomically( tmpName, manifestFileName( indexFile ) ) )
+  {
+    QFile::remove( tmpName );
+    return false;
+  }
+
+  return true;
+}
+
+/// The indices known by the sampled fingerprints of the dictionaries they
+/// were built for, from both the index directory and the shared one. This
+/// lets a dictionary reuse the index of an identical one found elsewhere.
+class IndexStore
+{
+  QMutex mutex;
+  bool scanned = false;
+  QMultiHash< QByteArray, QString > indices;
+
+  void scan( QString const & dir );
+
+  /// The fingerprint goes along with what follows the dictionary id in the
+  /// index name, so e.g. a full-text search index never stands for the main one
+  static QByteArray key( QByteArray const & fingerprint, QString const & indexFile )
+  { return fingerprint + '/' + QFileInfo( indexFile ).fileName().mid( 32 ).toUtf8(); }
+
+public:
+
+  void add( QByteArray const & sample, QString const & indexFile );
+
+  /// Copies an index built for the same contents to the given index file.
+  /// The sampled fingerprint only picks the candidates, the whole-content
+  /// one decides. Returns false if there's none.
+  bool reuse( DictionaryContents & contents, QString const & indexFile );
+};
+
+void IndexStore::scan( QString const & dir )
+{
+  if ( dir.isEmpty() )
+    return;
+
+  QDir indexDir( dir );
+
+  QStringList manifests = indexDir.entryList( QStringList( "*.manifest" ), QDir::Files );
+
+  for ( QString const & name : manifests )
+  {
+    QString indexFile = indexDir.filePath( name.left( name.size() - 9 ) );
+
+    IndexManifest manifest;
+
+    if ( manifest.read( indexFile ) && !manifest.sample.isEmpty() )
+      indices.insert( key( manifest.sample, indexFile ), indexFile );
+  }
+}
+
+void IndexStore::add( QByteArray const & sample, QString const & indexFile )
+{
+  QMutexLocker _( &mutex );
+
+  if ( scanned && !indices.contains( key( sample, indexFile ), indexFile ) )
+    indices.insert( key( sample, indexFile ), indexFile );
+}
+
+bool IndexStore::reuse( DictionaryContents & contents, QString const & indexFile )
+{
+  QByteArray sample;
+
+  if ( !contents.getSample( sample ) )
+    return false;
+
+  QMutexLocker _( &mutex );
+
+  if ( !scanned )
+  {
+    scan( Config::getIndexDir() );
+    scan( Config::getSharedIndexDir() );
+    scanned = true;
+  }
+
+  QList< QString > candidates = indices.values( key( sample, indexFile ) );
+
+  for ( QString const & candidate : candidates )
+  {
+    // Only single-file indices can be copied
+    if ( !QFileInfo( candidate ).isFile() || QFileInfo( candidate ) == QFileInfo( indexFile ) )
+      continue;
+
+    // The candidate could have been rebuilt since, for something else. The
+    // shared indices are copied around, so their timestamps don't count.
+    IndexManifest manifest;
+
+    if ( !manifest.read( candidate ) || manifest.sample != sample
+         || manifest.indexSize != QFileInfo( candidate ).size() )
+      continue;
+
+    // Same samples don't make same dictionaries. A candidate whose whole
+    // fingerprint isn't made yet can't be told apart.
+    if ( manifest.whole.isEmpty() )
+      continue;
+
+    QByteArray whole;
+
+    if ( !contents.getWhole( whole ) )
+      return false;
+
+    if ( manifest.whole != whole )
+      continue;
+
+    // The index in use, if any, is only replaced by a complete copy
+    QString tmpFile = indexFile + ".tmp";
+
+    QFile::remove( tmpFile );
+
+    if ( !QFile::copy( candidate, tmpFile ) )
+    {
+      QFile::remove( tmpFile );
+      continue;
+    }
+
+    // The copy of a read-only shared index must be writable to be rebuilt
+    QFile::setPermissions( tmpFile, QFile::ReadOwner | QFile::WriteOwner );
+
+    if ( !renameAtomically( tmpFile, indexFile ) )
+    {
+      QFile::remove( tmpFile );
+      continue;
+    }
+
+    manifest.files = contents.getFiles();
+    manifest.write( indexFile );
+
+    if ( !indices.contains( key( sample, indexFile ), indexFile ) )
+      indices.insert( key( sample, indexFile ), indexFile );
+
+    return true;
+  }
+
+  return false;
+}
+
+IndexStore & indexStore()
+{
+  static IndexStore store;
+
+  return store;
+}
+
+/// Makes the whole-content fingerprints of the dictionaries in background,
+/// one at a time, and puts them into their manifests. This takes reading
+/// the dictionaries in full, so it's not done while loading them.
+class WholeFingerprints
+{
+  QThreadPool pool;
+  QAtomicInt stopped;
+
+  QMutex mutex;
+  /// The fingerprints made so far, by the sampled ones. The main index and
+  /// the full-text search one of a dictionary share the same.
+  QMultiHash< QByteArray, std::pair< vector< FileStamp >, QByteArray > > made;
+
+  class Maker;
+
+public:
+
+  WholeFingerprints()
+  { pool.setMaxThreadCount( 1 ); }
+
+  /// Whatever is left undone gets done next time
+  ~WholeFingerprints()
+  {
+    stopped.ref();
+    pool.clear();
+    pool.waitForDone();
+  }
+
+  /// Makes the fingerprint for the manifest of the given index, if the
+  /// manifest still lists the same files by then
+  void schedule( vector< FileStamp > const & files, QByteArray const & sample,
+                 QString const & indexFile );
+};
+
+class WholeFingerprints::Maker: public QRunnable
+{
+  WholeFingerprints & owner;
+  vector< FileStamp > files;
+  QByteArray sample;
+  QString indexFile;
+
+public:
+
+  Maker( WholeFingerprints & owner_, vector< FileStamp > const & files_,
+         QByteArray const & sample_, QString const & indexFile_ ):
+    owner( owner_ ), files( files_ ), sample( sample_ ), indexFile( indexFile_ )
+  {}
+
+  virtual void run();
+};
+
+void WholeFingerprints::Maker::run()
+{
+  IndexManifest manifest;
+
+  if ( !manifest.read( indexFile ) || manifest.sample != sample || !( manifest.files == files )
+       || !manifest.whole.isEmpty() || !manifest.fits( QFileInfo( indexFile ) ) )
+    return;
+
+  QByteArray whole;
+
+  {
+    QMutexLocker _( &owner.mutex );
+
+    auto it = owner.made.constFind( sample );
+
+    for ( ; it != owner.made.constEnd() && it.key() == sample; ++it )
+      if ( it.value().first == files )
+        whole = it.value().second;
+  }
+
+  if ( whole.isEmpty() )
+  {
+    if ( !makeContentFingerprint( files, true, whole, &owner.stopped ) )
+      return;
+
+    // The files shouldn't have been touched while being read
+    for ( FileStamp const & stamp : files )
     {
-      if ( !fileInfo.exists() )
-        return true;
-      ts = fileInfo.lastModified().toSecsSinceEpoch();
+      QFileInfo fileInfo( stamp.name );
+
+      if ( fileInfo.size() != stamp.size || fileInfo.lastModified().toMSecsSinceEpoch() != stamp.modified )
+        return;
     }
 
-    if ( ts > lastModified )
-      lastModified = ts;
+    QMutexLocker _( &owner.mutex );
+    owner.made.insert( sample, std::make_pair( files, whole ) );
   }
 
+  // The index could have been rebuilt meanwhile
+  IndexManifest current;
+
+  if ( !current.read( indexFile ) || current.sample != sample || !( current.files == files )
+       || !current.fits( QFileInfo( indexFile ) ) )
+    return;
+
+  current.whole = whole;
+  current.write( indexFile );
+}
+
+void WholeFingerprints::schedule( vector< FileStamp > const & files, QByteArray const & sample,
+                                  QString const & indexFile )
+{
+  if ( !Utils::AtomicInt::loadAcquire( stopped ) )
+    pool.start( new Maker( *this, files, sample, indexFile ) );
+}
+
+WholeFingerprints & wholeFingerprints()
+{
+  static WholeFingerprints fingerprints;
+
+  return fingerprints;
+}
+
+/// Writes a manifest of the given index, built from the given files as they
+/// are now. The whole-content fingerprint is left to be made in background.
+void writeManifest( vector< FileStamp > const & files, DictionaryContents & contents,
+                    QString const & indexName )
+{
+  IndexManifest manifest;
+
+  if ( !contents.getSample( manifest.sample ) )
+    return;
+
+  manifest.files = files;
+
+  if ( !manifest.write( indexName ) )
+    return;
 
-  QFileInfo fileInfo( indexFile.c_str() );
+  indexStore().add( manifest.sample, indexName );
+  wholeFingerprints().schedule( files, manifest.sample, indexName );
+}
+
+bool isIndexOlderThanFiles( vector< FileStamp > const & files,
+                            QFileInfo const & indexInfo )
+{
+  for( vector< FileStamp >::const_iterator i = files.begin(); i != files.end(); ++i )
+    if ( indexInfo.lastModified().toSecsSinceEpoch() < i->modified / 1000 )
+      return true;
+
+  return false;
+}
 
-  if ( !fileInfo.exists() )
+} // namespace
+
+bool needToRebuildIndex( vector< string > const & dictionaryFiles,
+                         string const & indexFile ) noexcept
+{
+  vector< FileStamp > files;
+
+  if ( !stampDictionaryFiles( dictionaryFiles, files ) )
     return true;
 
-  return fileInfo.lastModified().toSecsSinceEpoch() < lastModified;
+  QString indexName = QString::fromUtf8( indexFile.c_str() );
+  QFileInfo indexInfo( indexName );
+
+  // Without any files to go by, only a missing index needs building
+  if ( files.empty() )
+    return !indexInfo.exists();
+
+  DictionaryContents contents( files );
+
+  if ( indexInfo.exists() )
+  {
+    IndexManifest manifest;
+
+    if ( manifest.read( indexName ) && manifest.fits( indexInfo ) )
+    {
+      // Untouched files need no reading
+      if ( manifest.files == files )
+      {
+        // Unless the whole-content fingerprint wasn't done last time
+        if ( manifest.whole.isEmpty() )
+          wholeFingerprints().schedule( files, manifest.sample, indexName );
+
+        return false;
+      }
+
+      // Touched or copied files are only taken for the same if they hold
+      // the same contents in full
+      QByteArray sample, whole;
+
+      if ( !manifest.whole.isEmpty() && contents.getSample( sample ) && sample == manifest.sample
+           && contents.getWhole( whole ) && whole == manifest.whole )
+      {
+        manifest.files = files;
+        manifest.write( indexName );
+
+        return false;
+      }
+    }
+
+    if ( !isIndexOlderThanFiles( files, indexInfo ) )
+    {
+      // The index has no manifest, e.g. it predates them. Being newer than
+      // the files, it was built from what they hold now, so from now on it
+      // is told up to date by their contents.
+      writeManifest( files, contents, indexName );
+
+      return false;
+    }
+  }
+
+  return !indexStore().reuse( contents, indexName );
+}
+
+void indexBuilt( vector< string > const & dictionaryFiles,
+                 string const & indexFile ) noexcept
+{
+  vector< FileStamp > files;
+
+  if ( !stampDictionaryFiles( dictionaryFiles, files ) || files.empty() )
+    return;
+
+  DictionaryContents contents( files );
+
+  writeManifest( files, contents, QString::fromUtf8( indexFile.c_str() ) );
 }
 
 string getFtsSuffix()
@@ -480,7 +480,20 @@ public:
   /// Retrieve all dictionary headwords
   virtual bool getHeadwords( QStringList & )
   { return false; }
-  virtual  void findHeadWordsWithLenth( int &, QSet< QString > * /*headwords*/, uint32_t ){}
+
+  /// Retrieves headwords page by page, in the index order, without loading
+  /// all of them at once. 'position' is an opaque cursor: pass 0 to start
+  /// from the first headword, and the value left by the previous call to
+  /// continue from there. At least 'length' headwords are appended unless
+  /// the end is reached. Returns false when there is nothing more to read.
+  virtual bool findHeadWordsWithLenth( uint32_t & /*position*/, QStringList & /*headwords*/, uint32_t )
+  { return false; }
+
+  /// Sets the cursor of findHeadWordsWithLenth() to the headwords beginning
+  /// with the given prefix, or following it in the index order. Some of them
+  /// may be appended already. Returns false when there is nothing more to read.
+  virtual bool findHeadWordsFrom( QString const & /*prefix*/, uint32_t & /*position*/, QStringList & /*headwords*/ )
+  { return false; }
 
   /// Enable/disable search via synonyms
   void setSynonymSearchEnabled( bool enabled )
@@ -500,6 +513,12 @@ public:
   /// The dictionaryName is in utf8.
   virtual void indexingDictionary( string const & dictionaryName ) noexcept=0;
 
+  /// Called by the Format instance when the index of a dictionary needs
+  /// building, before doing so. If true is returned, that dictionary is to be
+  /// skipped: its index gets built by a later load of the given files instead.
+  virtual bool isIndexingDeferred( vector< string > const & /*dictionaryFiles*/ ) noexcept
+  { return false; }
+
   virtual ~Initializing() = default;
 };
 
@@ -510,14 +529,26 @@ public:
 /// This function is supposed to be used by dictionary implementations.
 string makeDictionaryId( vector< string > const & dictionaryFiles ) noexcept;
 
-/// Checks if it is needed to regenerate index file based on its timestamp
-/// and the timestamps of the dictionary files. If some files are newer than
-/// the index file, or the index file doesn't exist, returns true. If some
-/// dictionary files don't exist, returns true, too.
+/// Checks if it is needed to regenerate index file. The index is up to date
+/// if its manifest lists the dictionary files with the same sizes and times,
+/// or else holds the same fingerprint of their whole contents, so copied or
+/// touched files don't matter. The time of the index itself doesn't count
+/// either, only its size. An index without a manifest is checked by the
+/// timestamps, then gets one.
+/// If the index isn't up to date, but an index of identical dictionary files
+/// is found in the index directory or in the shared one, it is copied over
+/// and false is returned. If some dictionary files don't exist, returns true.
 /// This function is supposed to be used by dictionary implementations.
 bool needToRebuildIndex( vector< string > const & dictionaryFiles,
                          string const & indexFile ) noexcept;
 
+/// Writes the manifest of the index just built from the given dictionary
+/// files, so needToRebuildIndex() tells it up to date without reading them.
+/// This function is supposed to be called by dictionary implementations
+/// once the index is in place.
+void indexBuilt( vector< string > const & dictionaryFiles,
+                 string const & indexFile ) noexcept;
+
 string getFtsSuffix();
 /// Returns a random dictionary id useful for interactively created
 /// dictionaries.
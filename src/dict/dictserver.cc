@@ -6,6 +6,8 @@
 #include <QUrl>
 #include <QTcpSocket>
 #include <QString>
+#include <QElapsedTimer>
+#include <QThread>
 #include <list>
 #include "gddebug.hh"
 #include "htmlescape.hh"
@@ -18,7 +20,9 @@ namespace DictServer {
 using namespace Dictionary;
 
 enum {
-  DefaultPort = 2628
+  DefaultPort = 2628,
+  MaxIdleConnections = 4, // Per dictionary
+  MaxIdleTime = 60000 // Milliseconds, idle connections older than that are closed
 };
 
 namespace {
@@ -184,6 +188,17 @@ class DictServerDictionary: public Dictionary::Class
   QStringList strategies;
   QStringList serverDatabases;
 
+  /// Connections which have already been greeted and authenticated, kept
+  /// open for the next requests. They have no thread affinity while idle.
+  struct IdleConnection
+  {
+    QTcpSocket * socket;
+    QElapsedTimer idleTime;
+  };
+
+  QMutex connectionsMutex;
+  std::list< IdleConnection > idleConnections;
+
 public:
 
   DictServerDictionary( string const & id, string const & name_,
@@ -210,6 +225,15 @@ public:
       strategies.append( "prefix" );
   }
 
+  ~DictServerDictionary() override
+  {
+    for( auto & c : idleConnections )
+    {
+      c.socket->abort();
+      delete c.socket;
+    }
+  }
+
   string getName() noexcept override
   { return name; }
 
@@ -242,6 +266,14 @@ protected:
 
   void getServerDatabases();
 
+  /// Returns a connection to the server, ready for the commands. An idle one
+  /// is reused if possible. Returns nullptr on failure, with errorString set.
+  QTcpSocket * getConnection( QString & errorString, QAtomicInt & isCancelled );
+
+  /// Keeps the connection for the next requests if it's reusable, that is,
+  /// all the replies to the commands sent have been read. Closes it otherwise.
+  void releaseConnection( QTcpSocket * socket, bool reusable, QAtomicInt & isCancelled );
+
   friend class DictServerWordSearchRequest;
   friend class DictServerArticleRequest;
 };
@@ -348,6 +380,82 @@ void DictServerDictionary::getServerDatabases()
   delete socket;
 }
 
+QTcpSocket * DictServerDictionary::getConnection( QString & errorString, QAtomicInt & isCancelled )
+{
+  for( ; ; )
+  {
+    QTcpSocket * socket;
+
+    {
+      QMutexLocker _( &connectionsMutex );
+
+      if( idleConnections.empty() )
+        break;
+
+      IdleConnection c = idleConnections.front();
+      idleConnections.pop_front();
+
+      socket = c.socket;
+
+      if( c.idleTime.elapsed() >= MaxIdleTime )
+      {
+        socket->abort();
+        delete socket;
+        continue;
+      }
+    }
+
+    socket->moveToThread( QThread::currentThread() );
+
+    // A server closing an idle connection sends some farewell or just EOF,
+    // either of which makes the socket readable
+    if( socket->state() == QTcpSocket::ConnectedState && !socket->bytesAvailable()
+        && !socket->waitForReadyRead( 0 ) && socket->state() == QTcpSocket::ConnectedState )
+      return socket;
+
+    socket->abort();
+    delete socket;
+  }
+
+  QTcpSocket * socket = new QTcpSocket;
+
+  if( connectToServer( *socket, url, errorString, isCancelled ) )
+    return socket;
+
+  socket->abort();
+  delete socket;
+  return nullptr;
+}
+
+void DictServerDictionary::releaseConnection( QTcpSocket * socket, bool reusable, QAtomicInt & isCancelled )
+{
+  if( Utils::AtomicInt::loadAcquire( isCancelled ) )
+  {
+    socket->abort();
+    delete socket;
+    return;
+  }
+
+  if( reusable && socket->state() == QTcpSocket::ConnectedState && !socket->bytesAvailable() )
+  {
+    QMutexLocker _( &connectionsMutex );
+
+    if( idleConnections.size() < MaxIdleConnections )
+    {
+      socket->moveToThread( nullptr );
+
+      IdleConnection c;
+      c.socket = socket;
+      c.idleTime.start();
+      idleConnections.push_back( c );
+      return;
+    }
+  }
+
+  disconnectFromServer( *socket );
+  delete socket;
+}
+
 class DictServerWordSearchRequest: public Dictionary::WordSearchRequest
 {
   QAtomicInt isCancelled;
@@ -389,30 +497,40 @@ void DictServerWordSearchRequest::run()
     return;
   }
 
-  socket = new QTcpSocket;
+  socket = dict.getConnection( errorString, isCancelled );
 
-  if( !socket )
-  {
-    finish();
-    return;
-  }
+  bool reusable = false;
 
-  if( connectToServer( *socket, dict.url, errorString, isCancelled ) )
+  if( socket )
   {
     QStringList matchesList;
 
+    // All the commands are sent at once (RFC 2229, 2.2 allows pipelining),
+    // and the replies are read in the same order
+    QString matchReqs;
+
     for( int ns = 0; ns < dict.strategies.size(); ns++ )
     {
       for( int i = 0; i < dict.databases.size(); i++ )
       {
-        QString matchReq = QString( "MATCH " )
-                           + dict.databases.at( i )
-                           + " " + dict.strategies.at( ns )
-                           + " \"" + QString::fromStdU32String( word )
-                           + "\"\r\n";
-        socket->write( matchReq.toUtf8() );
-        socket->waitForBytesWritten( 1000 );
+        matchReqs += QString( "MATCH " )
+                     + dict.databases.at( i )
+                     + " " + dict.strategies.at( ns )
+                     + " \"" + QString::fromStdU32String( word )
+                     + "\"\r\n";
+      }
+    }
+
+    socket->write( matchReqs.toUtf8() );
+    socket->waitForBytesWritten( 1000 );
 
+    bool okPending = false; // The "250 ok" which ends a list of matches is yet to be read
+    bool allRead = false;
+
+    for( int ns = 0; ns < dict.strategies.size(); ns++ )
+    {
+      for( int i = 0; i < dict.databases.size(); i++ )
+      {
         if( Utils::AtomicInt::loadAcquire( isCancelled ) )
           break;
 
@@ -427,6 +545,8 @@ void DictServerWordSearchRequest::run()
         if( reply.left( 3 ) == "250" )
         {
           // "OK" reply - matches info will be later
+          okPending = false;
+
           if( !readLine( *socket, reply, errorString, isCancelled ) )
             break;
 
@@ -452,6 +572,8 @@ void DictServerWordSearchRequest::run()
         if( reply.left( 3 ) == "152" )
         {
           // Matches found
+          okPending = true;
+
           int countPos = reply.indexOf( ' ', 4 );
 
           // Get matches count
@@ -492,11 +614,24 @@ void DictServerWordSearchRequest::run()
       if( Utils::AtomicInt::loadAcquire( isCancelled ) || !errorString.isEmpty() )
         break;
 
+      // The replies of the other strategies are still read, so that the
+      // connection could be reused
       matchesList.removeDuplicates();
-      if( matchesList.size() >= MAX_MATCHES_COUNT )
-        break;
+
+      if( ns == dict.strategies.size() - 1 )
+        allRead = true;
+    }
+
+    if( allRead && okPending )
+    {
+      QString reply;
+
+      if( readLine( *socket, reply, errorString, isCancelled ) && reply.left( 3 ) == "250" )
+        okPending = false;
     }
 
+    reusable = allRead && !okPending;
+
     if( !Utils::AtomicInt::loadAcquire( isCancelled ) && errorString.isEmpty() )
     {
       matchesList.removeDuplicates();
@@ -518,12 +653,10 @@ void DictServerWordSearchRequest::run()
     gdWarning( "Prefix find in \"%s\" fault: %s\n", dict.getName().c_str(),
                 errorString.toUtf8().data() );
 
-  if( Utils::AtomicInt::loadAcquire( isCancelled ) )
-    socket->abort();
-  else
-    disconnectFromServer( *socket );
+  if( socket )
+    dict.releaseConnection( socket, reusable && errorString.isEmpty(), isCancelled );
 
-  delete socket;
+  socket = nullptr;
   if( !Utils::AtomicInt::loadAcquire( isCancelled ) )
     finish();
 }
@@ -577,26 +710,34 @@ void DictServerArticleRequest::run()
     return;
   }
 
-  socket = new QTcpSocket;
+  socket = dict.getConnection( errorString, isCancelled );
 
-  if( !socket )
-  {
-    finish();
-    return;
-  }
+  bool reusable = false;
 
-  if( connectToServer( *socket, dict.url, errorString, isCancelled ) )
+  if( socket )
   {
     string articleData;
 
+    // All the commands are sent at once, and the replies are read in the
+    // same order
+    QString defineReqs;
+
     for( int i = 0; i < dict.databases.size(); i++ )
     {
-      QString defineReq = QString( "DEFINE " )
-                         + dict.databases.at( i )
-                         + " \"" + QString::fromStdU32String( word ) + "\"\r\n";
-      socket->write( defineReq.toUtf8() );
-      socket->waitForBytesWritten( 1000 );
+      defineReqs += QString( "DEFINE " )
+                    + dict.databases.at( i )
+                    + " \"" + QString::fromStdU32String( word ) + "\"\r\n";
+    }
 
+    socket->write( defineReqs.toUtf8() );
+    socket->waitForBytesWritten( 1000 );
+
+    bool okPending = false; // The "250 ok" which ends a list of definitions is yet to be read
+    bool malformed = false;
+    int i;
+
+    for( i = 0; i < dict.databases.size(); i++ )
+    {
       QString reply;
 
       if( Utils::AtomicInt::loadAcquire( isCancelled ) )
@@ -611,6 +752,8 @@ void DictServerArticleRequest::run()
       if( reply.left( 3 ) == "250" )
       {
         // "OK" reply - matches info will be later
+        okPending = false;
+
         if( !readLine( *socket, reply, errorString, isCancelled ) )
           break;
 
@@ -636,6 +779,8 @@ void DictServerArticleRequest::run()
       if( reply.left( 3 ) == "150" )
       {
         // Articles found
+        okPending = true;
+
         int countPos = reply.indexOf( ' ', 4 );
 
         QString articleText;
@@ -653,7 +798,10 @@ void DictServerArticleRequest::run()
             break;
 
           if( reply.left( 3 ) == "250" )
+          {
+            okPending = false;
             break;
+          }
 
           if( reply.left( 3 ) == "151" )
           {
@@ -669,6 +817,7 @@ void DictServerArticleRequest::run()
             if( endPos < pos )
             {
               // It seems mailformed string
+              malformed = true;
               break;
             }
 
@@ -682,6 +831,7 @@ void DictServerArticleRequest::run()
             if( endPos < pos )
             {
               // It seems mailformed string
+              malformed = true;
               break;
             }
 
@@ -698,6 +848,7 @@ void DictServerArticleRequest::run()
             if( endPos < pos )
             {
               // It seems mailformed string
+              malformed = true;
               break;
             }
 
@@ -830,8 +981,22 @@ void DictServerArticleRequest::run()
           if( Utils::AtomicInt::loadAcquire( isCancelled ) || !errorString.isEmpty() )
             break;
         }
+
+        if( Utils::AtomicInt::loadAcquire( isCancelled ) || !errorString.isEmpty() || malformed )
+          break;
       }
     }
+
+    if( i == dict.databases.size() && okPending && !malformed )
+    {
+      QString reply;
+
+      if( readLine( *socket, reply, errorString, isCancelled ) && reply.left( 3 ) == "250" )
+        okPending = false;
+    }
+
+    reusable = i == dict.databases.size() && !okPending && !malformed;
+
     if( !Utils::AtomicInt::loadAcquire( isCancelled ) && errorString.isEmpty() && !articleData.empty() )
     {
       QMutexLocker _( &dataMutex );
@@ -847,12 +1012,10 @@ void DictServerArticleRequest::run()
     gdWarning( "Articles request from \"%s\" fault: %s\n", dict.getName().c_str(),
                 errorString.toUtf8().data() );
 
-  if( Utils::AtomicInt::loadAcquire( isCancelled ) )
-    socket->abort();
-  else
-    disconnectFromServer( *socket );
+  if( socket )
+    dict.releaseConnection( socket, reusable && errorString.isEmpty(), isCancelled );
 
-  delete socket;
+  socket = nullptr;
   if( !Utils::AtomicInt::loadAcquire( isCancelled ) )
     finish();
 }
@@ -83,7 +83,7 @@ DEF_EX_STR( exDictzipError, "DICTZIP error", Dictionary::Ex )
 enum
 {
   Signature = 0x584c5344, // DSLX on little-endian, XLSD on big-endian
-  CurrentFormatVersion = 23 + BtreeIndexing::FormatVersion + Folding::Version,
+  CurrentFormatVersion = 23 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version,
   CurrentZipSupportVersion = 2,
   CurrentFtsIndexVersion = 7
 };
@@ -151,7 +151,6 @@ class DslDictionary: public BtreeIndexing::BtreeDictionary
   map< string, string > abrv;
   QMutex dzMutex;
   dictData * dz;
-  QMutex resourceZipMutex;
   IndexedZip resourceZip;
   BtreeIndex resourceZipIndex;
 
@@ -885,10 +884,7 @@ string DslDictionary::nodeToHtml( ArticleDom::Node const & node )
           {
             // Try reading from zip file
             if ( resourceZip.isOpen() )
-            {
-              QMutexLocker _( &resourceZipMutex );
               resourceZip.loadFile( Utf8::decode( filename ), imgdata );
-            }
           }
         }
       }
@@ -1915,6 +1911,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile, zipFileName.size() ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         DslScanner scanner( fileName );
 
         try { // Here we intercept any errors during the read to save line at
@@ -1929,7 +1928,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           gdDebug( "Dsl: Building the index for dictionary: %s\n",
                    QString::fromStdU32String( scanner.getDictionaryName() ).toUtf8().data() );
 
-          File::Class idx( indexFile, "wb" );
+          File::Replacement idx( indexFile );
 
           IdxHeader idxHeader;
 
@@ -2337,6 +2336,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.rewind();
 
         idx.write( &idxHeader, sizeof( idxHeader ) );
+        idx.commit();
+        Dictionary::indexBuilt( dictFiles, indexFile );
 
       } // In-place try for saving line count
       catch( ... )
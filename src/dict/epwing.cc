@@ -48,7 +48,7 @@ namespace {
 enum
 {
   Signature = 0x58575045, // EPWX on little-endian, XWPE on big-endian
-  CurrentFormatVersion = 6 + BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 6 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 struct IdxHeader
@@ -165,6 +165,10 @@ public:
                                                              unsigned long ) override
     ;
 
+  /// The search also looks for the words in the book itself
+  bool canRefinePrefixMatches() const override
+  { return false; }
+
   sptr< Dictionary::WordSearchRequest > stemmedMatch( wstring const &,
                                                               unsigned minLength,
                                                               unsigned maxSuffixVariation,
@@ -1279,13 +1283,16 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
                  indexIsOldOrBad( indexFile ) )
           {
+            if ( initializing.isIndexingDeferred( dictFiles ) )
+              continue; // It will be built in the background
+
             gdDebug( "Epwing: Building the index for dictionary in directory %s\n", dir.toUtf8().data() );
 
             QString str = dict.title();
             QByteArray nameData = str.toUtf8();
             initializing.indexingDictionary( nameData.data() );
 
-            File::Class idx( indexFile, "wb" );
+            File::Replacement idx( indexFile );
 
             IdxHeader idxHeader;
 
@@ -1343,6 +1350,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
             idx.rewind();
 
             idx.write( &idxHeader, sizeof( idxHeader ) );
+            idx.commit();
+            Dictionary::indexBuilt( dictFiles, indexFile );
 
 
           } // If need to rebuild
@@ -0,0 +1,627 @@
+#include "gdc.hh"
+#include "btreeidx.hh"
+#include "chunkedstorage.hh"
+#include "folding.hh"
+#include "gddebug.hh"
+#include "utf8.hh"
+#include "wstring_qt.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+
+#ifdef _MSC_VER
+#include <stub_msvc.h>
+#endif
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QTimer>
+#include <QUrl>
+
+#include "utils.hh"
+
+namespace Gdc {
+
+using std::map;
+using std::set;
+using gd::wstring;
+using BtreeIndexing::WordArticleLink;
+using BtreeIndexing::IndexedWords;
+using BtreeIndexing::IndexInfo;
+
+namespace {
+
+DEF_EX( exInvalidData, "Invalid data encountered", Dictionary::Ex )
+DEF_EX( exNoHeadwords, "The dictionary has no headwords to compile", Dictionary::Ex )
+DEF_EX( exTooBig, "The dictionary is too big to be compiled", Dictionary::Ex )
+
+enum
+{
+  Signature = 0x58434447, // GDCX on little-endian, XCDG on big-endian
+  CurrentFormatVersion = 1 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
+};
+
+struct IdxHeader
+{
+  uint32_t signature; // First comes the signature, GDCX
+  uint32_t formatVersion; // File format version (CurrentFormatVersion)
+  uint32_t chunksOffset; // The offset to chunks' storage
+  uint32_t indexBtreeMaxElements; // Two fields from IndexInfo
+  uint32_t indexRootOffset;
+  uint32_t resourceIndexBtreeMaxElements; // Two fields from IndexInfo of the
+  uint32_t resourceIndexRootOffset;       // resource names index
+  uint32_t wordCount;
+  uint32_t articleCount;
+  uint32_t resourceCount;
+  uint32_t langFrom;  // Source language
+  uint32_t langTo;    // Target language
+}
+#ifndef _MSC_VER
+__attribute__((packed))
+#endif
+;
+
+// The header is followed by the name, the id and the description of the
+// source dictionary, each one prefixed by its size. Every block in the
+// chunks is prefixed by its size too.
+
+bool isOldOrBad( string const & fileName )
+{
+  File::Class f( fileName, "rb" );
+
+  IdxHeader header;
+
+  return f.readRecords( &header, sizeof( header ), 1 ) != 1 ||
+         header.signature != Signature ||
+         header.formatVersion != CurrentFormatVersion;
+}
+
+string readString( File::Class & f )
+{
+  string result( f.read< uint32_t >(), '\0' );
+
+  if ( !result.empty() )
+    f.read( &result[ 0 ], result.size() );
+
+  return result;
+}
+
+void writeString( File::Class & f, string const & str )
+{
+  f.write( (uint32_t) str.size() );
+
+  if ( !str.empty() )
+    f.write( str.data(), str.size() );
+}
+
+class GdcDictionary: public BtreeIndexing::BtreeDictionary
+{
+  QMutex idxMutex;
+  File::Class idx;
+  IdxHeader idxHeader;
+  ChunkedStorage::Reader chunks;
+  BtreeIndexing::BtreeIndex resourceIndex;
+  string sourceId;
+
+public:
+
+  GdcDictionary( string const & id, vector< string > const & dictionaryFiles );
+
+  string getName() noexcept override
+  { return dictionaryName; }
+
+  map< Dictionary::Property, string > getProperties() noexcept override
+  { return map< Dictionary::Property, string >(); }
+
+  unsigned long getArticleCount() noexcept override
+  { return idxHeader.articleCount; }
+
+  unsigned long getWordCount() noexcept override
+  { return idxHeader.wordCount; }
+
+  inline quint32 getLangFrom() const override
+  { return idxHeader.langFrom; }
+
+  inline quint32 getLangTo() const override
+  { return idxHeader.langTo; }
+
+  sptr< Dictionary::DataRequest > getArticle( wstring const &,
+                                              vector< wstring > const & alts,
+                                              wstring const &,
+                                              bool ignoreDiacritics ) override
+    ;
+
+  sptr< Dictionary::DataRequest > getResource( string const & name ) override
+    ;
+
+protected:
+
+  void loadIcon() noexcept override;
+
+private:
+
+  /// Appends the block at the given address to the given string
+  void loadBlock( uint32_t address, string & result );
+};
+
+GdcDictionary::GdcDictionary( string const & id,
+                              vector< string > const & dictionaryFiles ):
+  BtreeDictionary( id, dictionaryFiles ),
+  idx( dictionaryFiles[ 0 ], "rb" ),
+  idxHeader( idx.read< IdxHeader >() ),
+  chunks( idx, idxHeader.chunksOffset )
+{
+  idx.seek( sizeof( idxHeader ) );
+
+  dictionaryName = readString( idx );
+  sourceId = readString( idx );
+  dictionaryDescription = QString::fromUtf8( readString( idx ).c_str() );
+
+  // Initialize the indices
+
+  openIndex( IndexInfo( idxHeader.indexBtreeMaxElements,
+                        idxHeader.indexRootOffset ),
+             idx, idxMutex );
+
+  resourceIndex.openIndex( IndexInfo( idxHeader.resourceIndexBtreeMaxElements,
+                                      idxHeader.resourceIndexRootOffset ),
+                           idx, idxMutex );
+}
+
+void GdcDictionary::loadBlock( uint32_t address, string & result )
+{
+  vector< char > chunk;
+
+  char * block = chunks.getBlock( address, chunk );
+
+  uint32_t size;
+
+  if ( block + sizeof( size ) > &chunk.front() + chunk.size() )
+    throw exInvalidData();
+
+  memcpy( &size, block, sizeof( size ) );
+  block += sizeof( size );
+
+  if ( size > (size_t)( &chunk.front() + chunk.size() - block ) )
+    throw exInvalidData();
+
+  result.append( block, size );
+}
+
+/// Every article holds all the source dictionary showed for its headword,
+/// the variants differing in case or diacritics included. So one article
+/// per word is enough: the one spelled the same way if there is one.
+bool findArticle( vector< WordArticleLink > const & links, wstring const & word,
+                  uint32_t & address )
+{
+  if ( links.empty() )
+    return false;
+
+  string const wordUtf8 = Utf8::encode( word );
+
+  address = links.front().articleOffset;
+
+  for( auto const & link : links )
+  {
+    if ( link.word == wordUtf8 )
+    {
+      address = link.articleOffset;
+      break;
+    }
+  }
+
+  return true;
+}
+
+sptr< Dictionary::DataRequest > GdcDictionary::getArticle( wstring const & word,
+                                                           vector< wstring > const & alts,
+                                                           wstring const &,
+                                                           bool ignoreDiacritics )
+
+{
+  vector< uint32_t > addresses;
+  uint32_t address;
+
+  if ( findArticle( findArticles( word, ignoreDiacritics ), word, address ) )
+    addresses.push_back( address );
+
+  for( auto const & alt : alts )
+  {
+    if ( findArticle( findArticles( alt, ignoreDiacritics ), alt, address ) &&
+         std::find( addresses.begin(), addresses.end(), address ) == addresses.end() )
+      addresses.push_back( address );
+  }
+
+  if ( addresses.empty() )
+    return std::make_shared< Dictionary::DataRequestInstant >( false ); // No such word
+
+  string result;
+
+  for( auto articleAddress : addresses )
+    loadBlock( articleAddress, result );
+
+  // The links to the resources were made for the source dictionary
+
+  string const from = "://" + sourceId + "/";
+  string const to = "://" + getId() + "/";
+
+  for( size_t pos = result.find( from ); pos != string::npos;
+       pos = result.find( from, pos + to.size() ) )
+    result.replace( pos, from.size(), to );
+
+  sptr< Dictionary::DataRequestInstant > ret =
+    std::make_shared< Dictionary::DataRequestInstant >( true );
+
+  ret->getData().assign( result.begin(), result.end() );
+
+  return ret;
+}
+
+sptr< Dictionary::DataRequest > GdcDictionary::getResource( string const & name )
+
+{
+  // Resource names are looked up exactly, the index only narrows them down
+
+  for( auto const & link : resourceIndex.findArticles( Utf8::decode( name ) ) )
+  {
+    if ( link.word != name )
+      continue;
+
+    string data;
+
+    loadBlock( link.articleOffset, data );
+
+    sptr< Dictionary::DataRequestInstant > ret =
+      std::make_shared< Dictionary::DataRequestInstant >( true );
+
+    ret->getData().assign( data.begin(), data.end() );
+
+    return ret;
+  }
+
+  return std::make_shared< Dictionary::DataRequestInstant >( false );
+}
+
+void GdcDictionary::loadIcon() noexcept
+{
+  if ( dictionaryIconLoaded )
+    return;
+
+  QString fileName = QDir::fromNativeSeparators( getDictionaryFilenames()[ 0 ].c_str() );
+
+  // Remove the extension
+  fileName.chop( 3 );
+
+  if( !loadIconFromFile( fileName ) )
+  {
+    // Load failed -- use default icons
+    dictionaryNativeIcon = dictionaryIcon = QIcon( ":/icons/dictionary.svg" );
+  }
+
+  dictionaryIconLoaded = true;
+}
+
+/// Waits for the request to finish, running the event loop of the calling
+/// thread meanwhile, which is the compiling one. The progress function keeps
+/// being called with the given count, so the compilation can be cancelled
+/// while waiting. Returns false if it was, cancelling the request as well.
+bool waitFor( Dictionary::Request & request,
+              std::function< bool( unsigned long ) > const & progress, unsigned long done )
+{
+  if ( request.isFinished() )
+    return true;
+
+  QEventLoop loop;
+  QTimer timer;
+  bool cancelled = false;
+
+  QObject::connect( &request, &Dictionary::Request::finished, &loop, &QEventLoop::quit );
+  QObject::connect( &timer, &QTimer::timeout, &loop, [ & ]() {
+    if ( !progress( done ) )
+    {
+      cancelled = true;
+      loop.quit();
+    }
+  } );
+
+  timer.start( 100 );
+
+  // It could have finished before the connection was made
+  if ( !request.isFinished() )
+    loop.exec();
+
+  if ( cancelled )
+    request.cancel();
+
+  return !cancelled;
+}
+
+/// Collects the names of the source dictionary's resources the article
+/// refers to
+void collectResourceNames( string const & article, string const & sourceId,
+                           set< string > & names )
+{
+  string const marker = "://" + sourceId + "/";
+
+  for( size_t pos = article.find( marker ); pos != string::npos;
+       pos = article.find( marker, pos + marker.size() ) )
+  {
+    size_t begin = pos;
+
+    while( begin && isalpha( (unsigned char)article[ begin - 1 ] ) )
+      --begin;
+
+    string const scheme = article.substr( begin, pos - begin );
+
+    if ( scheme != "bres" && scheme != "gdau" && scheme != "gdvideo" )
+      continue;
+
+    size_t end = article.find_first_of( "\"'<>() \t\r\n\\", pos + marker.size() );
+
+    if ( end == string::npos )
+      end = article.size();
+
+    QString link = QString::fromUtf8( article.data() + begin, end - begin );
+    link.replace( "&amp;", "&" );
+
+    QString name = Utils::Url::path( QUrl( link ) ).mid( 1 );
+
+    if ( !name.isEmpty() )
+      names.insert( name.toUtf8().toStdString() );
+  }
+}
+
+/// Appends a block prefixed by its size
+uint32_t addBlock( ChunkedStorage::Writer & chunks, vector< char > const & data )
+{
+  uint32_t address = chunks.startNewBlock();
+
+  uint32_t size = data.size();
+
+  chunks.addToBlock( &size, sizeof( size ) );
+  chunks.addToBlock( data.data(), data.size() );
+
+  return address;
+}
+
+bool writeCompiled( Dictionary::Class & dictionary, File::Class & idx,
+                    std::function< bool( unsigned long ) > const & progress )
+{
+  IdxHeader idxHeader;
+
+  memset( &idxHeader, 0, sizeof( idxHeader ) );
+
+  // We write a dummy header first. At the end of the process the header
+  // will be rewritten with the right values.
+
+  idx.write( idxHeader );
+
+  string const sourceId = dictionary.getId();
+
+  writeString( idx, dictionary.getName() );
+  writeString( idx, sourceId );
+  writeString( idx, dictionary.getDescription().toUtf8().toStdString() );
+
+  ChunkedStorage::Writer chunks( idx );
+
+  IndexedWords indexedWords, indexedResources;
+
+  // Identical articles, such as the ones of the case variants of a word,
+  // are only stored once
+  QHash< QByteArray, uint32_t > articleAddresses;
+
+  set< string > resourceNames;
+
+  uint32_t position = 0;
+  bool hasMore = true;
+  unsigned long done = 0;
+  QStringList page;
+
+  while( hasMore )
+  {
+    page.clear();
+
+    hasMore = dictionary.findHeadWordsWithLenth( position, page, 10000 );
+
+    for( QString const & headword : qAsConst( page ) )
+    {
+      wstring word = gd::toWString( headword );
+
+      try
+      {
+        sptr< Dictionary::DataRequest > req =
+          dictionary.getArticle( word, vector< wstring >(), wstring(), false );
+
+        if ( !waitFor( *req, progress, done ) )
+          return false;
+
+        if ( req->dataSize() > 0 )
+        {
+          vector< char > & data = req->getFullData();
+
+          QByteArray hash = QCryptographicHash::hash( QByteArray::fromRawData( data.data(), data.size() ),
+                                                      QCryptographicHash::Md5 );
+
+          auto i = articleAddresses.constFind( hash );
+
+          uint32_t address;
+
+          if ( i != articleAddresses.constEnd() )
+            address = *i;
+          else
+          {
+            address = addBlock( chunks, data );
+            articleAddresses.insert( hash, address );
+
+            collectResourceNames( string( data.data(), data.size() ), sourceId, resourceNames );
+          }
+
+          indexedWords.addWord( word, address );
+          ++idxHeader.wordCount;
+        }
+      }
+      catch( ChunkedStorage::exStorageFull & )
+      {
+        throw exTooBig();
+      }
+      catch( File::Ex & )
+      {
+        throw; // Writing failed, so does the whole thing
+      }
+      catch( std::exception & e )
+      {
+        gdWarning( "Gdc: failed to get the article for \"%s\" from \"%s\", error: %s\n",
+                   headword.toUtf8().data(), dictionary.getName().c_str(), e.what() );
+      }
+
+      if ( !progress( ++done ) )
+        return false;
+    }
+  }
+
+  if ( !done )
+    throw exNoHeadwords();
+
+  idxHeader.articleCount = articleAddresses.size();
+
+  // Now the resources
+
+  for( string const & name : resourceNames )
+  {
+    try
+    {
+      sptr< Dictionary::DataRequest > req = dictionary.getResource( name );
+
+      if ( !waitFor( *req, progress, done ) )
+        return false;
+
+      if ( req->dataSize() > 0 )
+      {
+        indexedResources.addSingleWord( Utf8::decode( name ),
+                                        addBlock( chunks, req->getFullData() ) );
+        ++idxHeader.resourceCount;
+      }
+    }
+    catch( ChunkedStorage::exStorageFull & )
+    {
+      throw exTooBig();
+    }
+    catch( File::Ex & )
+    {
+      throw;
+    }
+    catch( std::exception & e )
+    {
+      gdWarning( "Gdc: failed to get the resource \"%s\" from \"%s\", error: %s\n",
+                 name.c_str(), dictionary.getName().c_str(), e.what() );
+    }
+
+    if ( !progress( done ) )
+      return false;
+  }
+
+  try
+  {
+    idxHeader.chunksOffset = chunks.finish();
+  }
+  catch( ChunkedStorage::exStorageFull & )
+  {
+    throw exTooBig();
+  }
+
+  // Build the indices
+
+  IndexInfo idxInfo = BtreeIndexing::buildIndex( indexedWords, idx );
+
+  idxHeader.indexBtreeMaxElements = idxInfo.btreeMaxElements;
+  idxHeader.indexRootOffset = idxInfo.rootOffset;
+
+  IndexInfo resourceIdxInfo = BtreeIndexing::buildIndex( indexedResources, idx );
+
+  idxHeader.resourceIndexBtreeMaxElements = resourceIdxInfo.btreeMaxElements;
+  idxHeader.resourceIndexRootOffset = resourceIdxInfo.rootOffset;
+
+  // The offsets of the btree nodes are 32-bit, the same as the chunks' ones
+  if ( idx.tell() > UINT32_MAX )
+    throw exTooBig();
+
+  idxHeader.langFrom = dictionary.getLangFrom();
+  idxHeader.langTo = dictionary.getLangTo();
+
+  // That concludes it. Update the header.
+
+  idxHeader.signature = Signature;
+  idxHeader.formatVersion = CurrentFormatVersion;
+
+  idx.rewind();
+
+  idx.write( &idxHeader, sizeof( idxHeader ) );
+
+  return true;
+}
+
+} // anonymous namespace
+
+bool compile( Dictionary::Class & dictionary, string const & fileName,
+              std::function< bool( unsigned long ) > const & progress )
+{
+  // The file is written aside and only replaces the existing one once done,
+  // so whoever reads the previous version isn't affected
+  File::Replacement idx( fileName );
+
+  if ( !writeCompiled( dictionary, idx, progress ) )
+    return false;
+
+  idx.commit();
+
+  return true;
+}
+
+vector< sptr< Dictionary::Class > > makeDictionaries(
+                                      vector< string > const & fileNames,
+                                      string const &,
+                                      Dictionary::Initializing & )
+
+{
+  // The compiled files are indices themselves, so nothing is built here
+
+  vector< sptr< Dictionary::Class > > dictionaries;
+
+  for( auto const & fileName : fileNames )
+  {
+    if ( fileName.size() < 4 ||
+         strcasecmp( fileName.c_str() + ( fileName.size() - 4 ), ".gdc" ) != 0 )
+      continue;
+
+    try
+    {
+      if ( isOldOrBad( fileName ) )
+      {
+        gdWarning( "Gdc: %s was compiled by an incompatible version, it needs to be compiled again\n",
+                   fileName.c_str() );
+        continue;
+      }
+
+      vector< string > dictFiles( 1, fileName );
+
+      dictionaries.push_back( std::make_shared< GdcDictionary >( Dictionary::makeDictionaryId( dictFiles ),
+                                                                 dictFiles ) );
+    }
+    catch( std::exception & e )
+    {
+      gdWarning( "Compiled dictionary reading failed: %s, error: %s\n",
+                 fileName.c_str(), e.what() );
+    }
+  }
+
+  return dictionaries;
+}
+
+}
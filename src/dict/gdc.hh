@@ -0,0 +1,34 @@
+#ifndef __GDC_HH_INCLUDED__
+#define __GDC_HH_INCLUDED__
+
+#include "dictionary.hh"
+
+#include <functional>
+
+/// Support for the compiled dictionaries. Any dictionary able to list its
+/// headwords can be compiled into a single .gdc file which holds its articles
+/// the way they are shown, the resources they refer to and the index. Such a
+/// file is used as it is: nothing gets converted, decoded or indexed on
+/// lookups, and no separate index is built for it.
+namespace Gdc {
+
+using std::vector;
+using std::string;
+
+vector< sptr< Dictionary::Class > > makeDictionaries(
+                                      vector< string > const & fileNames,
+                                      string const & indicesDir,
+                                      Dictionary::Initializing & )
+  ;
+
+/// Compiles the given dictionary into the given file. The progress function
+/// is called with the number of headwords done so far, and returning false
+/// from it cancels the compilation, in which case false is returned. The
+/// file is only replaced once the compilation is complete, and is left as it
+/// was on cancelling or on errors. Throws on errors.
+bool compile( Dictionary::Class & dictionary, string const & fileName,
+              std::function< bool( unsigned long ) > const & progress );
+
+}
+
+#endif
@@ -309,7 +309,7 @@ DEF_EX_STR( exDictzipError, "DICTZIP error", Dictionary::Ex )
 enum
 {
   Signature = 0x58534c47, // GLSX on little-endian, XSLG on big-endian
-  CurrentFormatVersion = 1 + BtreeIndexing::FormatVersion + Folding::Version,
+  CurrentFormatVersion = 1 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version,
   CurrentZipSupportVersion = 2,
   CurrentFtsIndexVersion = 1
 };
@@ -361,7 +361,6 @@ class GlsDictionary: public BtreeIndexing::BtreeDictionary
   dictData * dz;
   ChunkedStorage::Reader chunks;
   QMutex dzMutex;
-  QMutex resourceZipMutex;
   IndexedZip resourceZip;
 
 public:
@@ -1316,6 +1315,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile, zipFileName.size() ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         GlsScanner scanner( *i );
 
         try { // Here we intercept any errors during the read to save line at
@@ -1327,7 +1329,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           gdDebug( "Gls: Building the index for dictionary: %s\n",
                    QString::fromStdU32String( scanner.getDictionaryName() ).toUtf8().data() );
 
-          File::Class idx( indexFile, "wb" );
+          File::Replacement idx( indexFile );
 
           IdxHeader idxHeader;
 
@@ -1486,6 +1488,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           idx.rewind();
 
           idx.write( &idxHeader, sizeof( idxHeader ) );
+          idx.commit();
+          Dictionary::indexBuilt( dictFiles, indexFile );
         } // In-place try for saving line count
         catch( ... )
         {
@@ -11,8 +11,10 @@
 #include "langcoder.hh"
 
 #include <QRunnable>
+#include <QThread>
 #include <QThreadPool>
 #include <QSemaphore>
+#include <QWaitCondition>
 #if (QT_VERSION >= QT_VERSION_CHECK(6,0,0))
 #include <QtCore5Compat/QRegExp>
 #else
@@ -22,6 +24,7 @@
 #include <QCoreApplication>
 #include <QFileInfo>
 
+#include <memory>
 #include <set>
 #ifndef INCLUDE_LIBRARY_PATH
 #include <hunspell.hxx>
@@ -41,17 +44,95 @@ using gd::wchar;
 
 namespace {
 
-class HunspellDictionary: public Dictionary::Class
+// We used to have a separate mutex for each Hunspell instance, assuming
+// that its code was reentrant (though probably not thread-safe). However,
+// crashes were discovered later when using several Hunspell dictionaries
+// simultaneously. Hunspell keeps process-wide tables which are set up and
+// freed as the objects get created and destroyed, so these are serialized
+// with a single mutex. Lookups on separate objects may run in parallel.
+QMutex & getHunspellMutex()
 {
-  string name;
-  Hunspell hunspell;
+  static QMutex mutex;
+  return mutex;
+}
 
-#ifdef Q_OS_WIN32
-  static string Utf8ToLocal8Bit( string const & name )
+/// The memory all the pools may spend on their extra Hunspell objects
+qint64 const PoolsMemoryBudget = 256 * 1024 * 1024;
+
+/// Reserves the given amount from the budget shared by all the pools.
+/// Returns false if it's exhausted.
+bool reservePoolMemory( qint64 size )
+{
+  static QMutex mutex;
+  static qint64 reserved = 0;
+
+  QMutexLocker _( &mutex );
+
+  if ( size > 0 && reserved + size > PoolsMemoryBudget )
+    return false;
+
+  reserved += size;
+  return true;
+}
+
+/// A Hunspell object can't be used by several threads at once, but separate
+/// objects can be used in parallel. Each dictionary keeps a pool of them,
+/// created on demand, and every caller checks one out for its exclusive use.
+/// Since each object holds the whole dictionary in memory, the objects past
+/// the first one of every pool are limited by a budget shared by all pools.
+class HunspellPool
+{
+public:
+
+  /// files[ 0 ] should be .aff file, files[ 1 ] should be .dic file.
+  HunspellPool( vector< string > const & files );
+  ~HunspellPool();
+
+  /// Checks out a Hunspell object for the lifetime of the handle, waiting
+  /// for one to be returned if the pool is exhausted.
+  class Handle
   {
-    return string( QString::fromUtf8( name.c_str() ).toLocal8Bit().data() );
-  }
-#endif
+    HunspellPool & pool;
+    std::unique_ptr< Hunspell > hunspell;
+
+  public:
+
+    explicit Handle( HunspellPool & pool_ ):
+      pool( pool_ ),
+      hunspell( pool_.checkOut() )
+    {
+    }
+
+    ~Handle()
+    {
+      pool.checkIn( std::move( hunspell ) );
+    }
+
+    Handle( Handle const & ) = delete;
+    Handle & operator=( Handle const & ) = delete;
+
+    Hunspell & get()
+    { return *hunspell; }
+  };
+
+private:
+
+  std::unique_ptr< Hunspell > checkOut();
+  void checkIn( std::unique_ptr< Hunspell > );
+
+  string affFile, dicFile;
+  qint64 instanceSize; // The estimated memory taken by one object
+  int maxInstances;
+  int instances; // Created so far, both idle and checked out
+  vector< std::unique_ptr< Hunspell > > idle;
+  QMutex mutex;
+  QWaitCondition released;
+};
+
+class HunspellDictionary: public Dictionary::Class
+{
+  string name;
+  HunspellPool hunspellPool;
 
 public:
 
@@ -60,11 +141,7 @@ public:
                       vector< string > const & files ):
     Dictionary::Class( id, files ),
     name( name_ ),
-#ifdef Q_OS_WIN32
-    hunspell( Utf8ToLocal8Bit( files[ 0 ] ).c_str(), Utf8ToLocal8Bit( files[ 1 ] ).c_str() )
-#else
-    hunspell( files[ 0 ].c_str(), files[ 1 ].c_str() )
-#endif
+    hunspellPool( files )
   {
   }
 
@@ -101,21 +178,93 @@ public:
 protected:
 
   void loadIcon() noexcept override;
+};
 
-private:
+#ifdef Q_OS_WIN32
+string Utf8ToLocal8Bit( string const & name )
+{
+  return string( QString::fromUtf8( name.c_str() ).toLocal8Bit().data() );
+}
+#endif
+
+HunspellPool::HunspellPool( vector< string > const & files ):
+#ifdef Q_OS_WIN32
+  affFile( Utf8ToLocal8Bit( files[ 0 ] ) ),
+  dicFile( Utf8ToLocal8Bit( files[ 1 ] ) ),
+#else
+  affFile( files[ 0 ] ),
+  dicFile( files[ 1 ] ),
+#endif
+  instances( 0 )
+{
+  // A loaded dictionary takes a few times the size of its files in memory
+  qint64 const filesSize = QFileInfo( QString::fromUtf8( files[ 0 ].c_str() ) ).size()
+                           + QFileInfo( QString::fromUtf8( files[ 1 ].c_str() ) ).size();
+  instanceSize = qMax< qint64 >( filesSize * 4, 1 );
+
+  maxInstances = qBound( 1, QThread::idealThreadCount(), 4 );
+}
+
+HunspellPool::~HunspellPool()
+{
+  // Every handle is gone by now, so all the objects are idle
+  if ( instances > 1 )
+    reservePoolMemory( -instanceSize * ( instances - 1 ) );
+
+  QMutexLocker _( &getHunspellMutex() );
+  idle.clear();
+}
+
+std::unique_ptr< Hunspell > HunspellPool::checkOut()
+{
+  {
+    QMutexLocker _( &mutex );
+
+    for( ;; )
+    {
+      if ( !idle.empty() )
+      {
+        std::unique_ptr< Hunspell > hunspell = std::move( idle.back() );
+        idle.pop_back();
+        return hunspell;
+      }
 
-  // We used to have a separate mutex for each Hunspell instance, assuming
-  // that its code was reentrant (though probably not thread-safe). However,
-  // crashes were discovered later when using several Hunspell dictionaries
-  // simultaneously, and we've switched to have a single mutex for all hunspell
-  // calls - evidently it's not really reentrant.
-  static QMutex & getHunspellMutex()
+      // The first object is always there to be made, the others only as
+      // long as the budget allows. If not, one of those in use gets returned
+      if ( instances == 0 || ( instances < maxInstances && reservePoolMemory( instanceSize ) ) )
+        break;
+
+      released.wait( &mutex );
+    }
+
+    ++instances;
+  }
+
+  // Loading takes a while, so other pools' lookups go on meanwhile. Only
+  // the loads and the unloads are serialized
+  try
   {
-    static QMutex mutex;
-    return mutex;
+    QMutexLocker _( &getHunspellMutex() );
+    return std::make_unique< Hunspell >( affFile.c_str(), dicFile.c_str() );
   }
-  //  QMutex hunspellMutex;
-};
+  catch( ... )
+  {
+    QMutexLocker _( &mutex );
+    if ( --instances > 0 )
+      reservePoolMemory( -instanceSize );
+    released.wakeOne();
+    throw;
+  }
+}
+
+void HunspellPool::checkIn( std::unique_ptr< Hunspell > hunspell )
+{
+  QMutexLocker _( &mutex );
+
+  idle.push_back( std::move( hunspell ) );
+
+  released.wakeOne();
+}
 
 /// Encodes the given string to be passed to the hunspell object. May throw
 /// Iconv::Ex
@@ -126,13 +275,12 @@ string encodeToHunspell( Hunspell &, wstring const & );
 wstring decodeFromHunspell( Hunspell &, char const * );
 
 /// Generates suggestions via hunspell
-QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & hunspell );
+QVector< wstring > suggest( wstring & word, Hunspell & hunspell );
 
 /// Generates suggestions for compound expression
 void getSuggestionsForExpression( wstring const & expression,
                                   vector< wstring > & suggestions,
-                                  QMutex & hunspellMutex,
-                                  Hunspell & hunspell );
+                                  HunspellPool & hunspellPool );
 
 /// Returns true if the string contains whitespace, false otherwise
 bool containsWhitespace( wstring const & str )
@@ -171,7 +319,7 @@ vector< wstring > HunspellDictionary::getAlternateWritings( wstring const & word
 
   if( containsWhitespace( word ) )
   {
-    getSuggestionsForExpression( word, results, getHunspellMutex(), hunspell );
+    getSuggestionsForExpression( word, results, hunspellPool );
   }
 
   return results;
@@ -182,8 +330,7 @@ vector< wstring > HunspellDictionary::getAlternateWritings( wstring const & word
 class HunspellArticleRequest: public Dictionary::DataRequest
 {
 
-  QMutex & hunspellMutex;
-  Hunspell & hunspell;
+  HunspellPool & hunspellPool;
   wstring word;
 
   QAtomicInt isCancelled;
@@ -191,9 +338,8 @@ class HunspellArticleRequest: public Dictionary::DataRequest
 
 public:
 
-  HunspellArticleRequest( wstring const & word_, QMutex & hunspellMutex_, Hunspell & hunspell_ ):
-    hunspellMutex( hunspellMutex_ ),
-    hunspell( hunspell_ ),
+  HunspellArticleRequest( wstring const & word_, HunspellPool & hunspellPool_ ):
+    hunspellPool( hunspellPool_ ),
     word( word_ )
   {
     f = QtConcurrent::run( [ this ]() {
@@ -236,7 +382,8 @@ void HunspellArticleRequest::run()
       return;
     }
 
-    QMutexLocker _( &hunspellMutex );
+    HunspellPool::Handle handle( hunspellPool );
+    Hunspell & hunspell = handle.get();
 
     string encodedWord = encodeToHunspell( hunspell, trimmedWord );
 
@@ -309,7 +456,7 @@ sptr< DataRequest > HunspellDictionary::getArticle( wstring const & word,
                                                     wstring const &, bool )
   
 {
-  return std::make_shared<HunspellArticleRequest>( word, getHunspellMutex(), hunspell );
+  return std::make_shared<HunspellArticleRequest>( word, hunspellPool );
 }
 
 /// HunspellDictionary::findHeadwordsForSynonym()
@@ -317,8 +464,7 @@ sptr< DataRequest > HunspellDictionary::getArticle( wstring const & word,
 class HunspellHeadwordsRequest: public Dictionary::WordSearchRequest
 {
 
-  QMutex & hunspellMutex;
-  Hunspell & hunspell;
+  HunspellPool & hunspellPool;
   wstring word;
 
   QAtomicInt isCancelled;
@@ -327,9 +473,8 @@ class HunspellHeadwordsRequest: public Dictionary::WordSearchRequest
 
 public:
 
-  HunspellHeadwordsRequest( wstring const & word_, QMutex & hunspellMutex_, Hunspell & hunspell_ ):
-    hunspellMutex( hunspellMutex_ ),
-    hunspell( hunspell_ ),
+  HunspellHeadwordsRequest( wstring const & word_, HunspellPool & hunspellPool_ ):
+    hunspellPool( hunspellPool_ ),
     word( word_ )
   {
     f = QtConcurrent::run( [ this ]() {
@@ -375,7 +520,7 @@ void HunspellHeadwordsRequest::run()
   {
     vector< wstring > results;
 
-    getSuggestionsForExpression( trimmedWord, results, hunspellMutex, hunspell );
+    getSuggestionsForExpression( trimmedWord, results, hunspellPool );
 
     QMutexLocker _( &dataMutex );
     for( unsigned i = 0; i < results.size(); i++ )
@@ -384,7 +529,12 @@ void HunspellHeadwordsRequest::run()
   }
   else
   {
-    QVector< wstring > suggestions = suggest( trimmedWord, hunspellMutex, hunspell );
+    QVector< wstring > suggestions;
+
+    {
+      HunspellPool::Handle handle( hunspellPool );
+      suggestions = suggest( trimmedWord, handle.get() );
+    }
 
     if ( !suggestions.empty() )
     {
@@ -398,15 +548,13 @@ void HunspellHeadwordsRequest::run()
   finish();
 }
 
-QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & hunspell )
+QVector< wstring > suggest( wstring & word, Hunspell & hunspell )
 {
   QVector< wstring > result;
 
   vector< string > suggestions;
 
   try {
-    QMutexLocker _( &hunspellMutex );
-
     string encodedWord = encodeToHunspell( hunspell, word );
 
     suggestions = hunspell.analyze( encodedWord );
@@ -416,7 +564,8 @@ QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & h
 
       wstring lowercasedWord = Folding::applySimpleCaseOnly( word );
 
-      static QRegExp cutStem( R"(^\s*st:(((\s+(?!\w{2}:)(?!-)(?!\+))|\S+)+))" );
+      // QRegExp keeps the match state, so each thread needs its own copy
+      thread_local QRegExp cutStem( R"(^\s*st:(((\s+(?!\w{2}:)(?!-)(?!\+))|\S+)+))" );
 
       for( vector< string >::size_type x = 0; x < suggestions.size(); ++x )
       {
@@ -456,7 +605,7 @@ QVector< wstring > suggest( wstring & word, QMutex & hunspellMutex, Hunspell & h
 sptr< WordSearchRequest > HunspellDictionary::findHeadwordsForSynonym( wstring const & word )
   
 {
-  return std::make_shared<HunspellHeadwordsRequest>( word, getHunspellMutex(), hunspell );
+  return std::make_shared<HunspellHeadwordsRequest>( word, hunspellPool );
 }
 
 
@@ -465,8 +614,7 @@ sptr< WordSearchRequest > HunspellDictionary::findHeadwordsForSynonym( wstring c
 class HunspellPrefixMatchRequest: public Dictionary::WordSearchRequest
 {
 
-  QMutex & hunspellMutex;
-  Hunspell & hunspell;
+  HunspellPool & hunspellPool;
   wstring word;
 
   QAtomicInt isCancelled;
@@ -474,9 +622,8 @@ class HunspellPrefixMatchRequest: public Dictionary::WordSearchRequest
 
 public:
 
-  HunspellPrefixMatchRequest( wstring const & word_, QMutex & hunspellMutex_, Hunspell & hunspell_ ):
-    hunspellMutex( hunspellMutex_ ),
-    hunspell( hunspell_ ),
+  HunspellPrefixMatchRequest( wstring const & word_, HunspellPool & hunspellPool_ ):
+    hunspellPool( hunspellPool_ ),
     word( word_ )
   {
     f = QtConcurrent::run( [ this ]() {
@@ -518,7 +665,8 @@ void HunspellPrefixMatchRequest::run()
       return;
     }
 
-    QMutexLocker _( &hunspellMutex );
+    HunspellPool::Handle handle( hunspellPool );
+    Hunspell & hunspell = handle.get();
 
     string encodedWord = encodeToHunspell( hunspell, trimmedWord );
 
@@ -543,13 +691,12 @@ sptr< WordSearchRequest > HunspellDictionary::prefixMatch( wstring const & word,
                                                            unsigned long /*maxResults*/ )
   
 {
-  return std::make_shared<HunspellPrefixMatchRequest>( word, getHunspellMutex(), hunspell );
+  return std::make_shared<HunspellPrefixMatchRequest>( word, hunspellPool );
 }
 
 void getSuggestionsForExpression( wstring const & expression,
                                   vector< wstring > & suggestions,
-                                  QMutex & hunspellMutex,
-                                  Hunspell & hunspell )
+                                  HunspellPool & hunspellPool )
 {
   // Analyze each word separately and use the first two suggestions, if any.
   // This is useful for compound expressions where some words is
@@ -597,6 +744,8 @@ void getSuggestionsForExpression( wstring const & expression,
 
   // Combine result strings from suggestions
 
+  HunspellPool::Handle handle( hunspellPool );
+
   QVector< wstring > results;
 
   for( int i = 0; i < words.size(); i++ )
@@ -609,7 +758,7 @@ void getSuggestionsForExpression( wstring const & expression,
     }
     else
     {
-      QVector< wstring > sugg = suggest( word, hunspellMutex, hunspell );
+      QVector< wstring > sugg = suggest( word, handle.get() );
       int suggNum = sugg.size() + 1;
       if( suggNum > 3 )
         suggNum = 3;
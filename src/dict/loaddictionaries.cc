@@ -31,6 +31,7 @@
 #include "dictserver.hh"
 #include "dict/slob.hh"
 #include "dict/gls.hh"
+#include "dict/gdc.hh"
 #include "dict/lingualibre.hh"
 #include "metadata.hh"
 
@@ -45,6 +46,7 @@
 #include <QMessageBox>
 #include <QDir>
 
+#include <algorithm>
 #include <set>
 
 using std::set;
@@ -52,20 +54,21 @@ using std::set;
 using std::string;
 using std::vector;
 
-LoadDictionaries::LoadDictionaries( Config::Class const & cfg ):
+LoadDictionaries::LoadDictionaries( Config::Class const & cfg, bool deferIndexing_ ):
   paths( cfg.paths ), soundDirs( cfg.soundDirs ), hunspell( cfg.hunspell ),
   transliteration( cfg.transliteration ),
   exceptionText( "Load did not finish" ), // Will be cleared upon success
   maxPictureWidth( cfg.maxPictureWidth ),
   maxHeadwordSize( cfg.maxHeadwordSize ),
-  maxHeadwordToExpand( cfg.maxHeadwordsToExpand )
+  maxHeadwordToExpand( cfg.maxHeadwordsToExpand ),
+  deferIndexing( deferIndexing_ )
 {
   // Populate name filters
 
   nameFilters << "*.bgl" << "*.ifo" << "*.lsa" << "*.dat"
               << "*.dsl" << "*.dsl.dz"  << "*.index" << "*.xdxf"
               << "*.xdxf.dz" << "*.dct" << "*.aar" << "*.zips"
-              << "*.mdx" << "*.gls" << "*.gls.dz"
+              << "*.mdx" << "*.gls" << "*.gls.dz" << "*.gdc"
 #ifdef MAKE_ZIM_SUPPORT
               << "*.zim" << "*.zimaa" << "*.slob"
 #endif
@@ -75,13 +78,37 @@ LoadDictionaries::LoadDictionaries( Config::Class const & cfg ):
 ;
 }
 
+LoadDictionaries::LoadDictionaries( Config::Class const & cfg,
+                                    vector< vector< string > > const & deferredDictionaries_ ):
+  LoadDictionaries( cfg )
+{
+  deferredDictionaries = deferredDictionaries_;
+
+  for( auto const & files : deferredDictionaries )
+    onlyFiles.insert( files.begin(), files.end() );
+
+  // Only the sound dirs among the files are of interest
+  Config::SoundDirs deferredSoundDirs;
+
+  for( auto const & soundDir : soundDirs )
+    if( onlyFiles.count( QDir::toNativeSeparators( QDir( soundDir.path ).canonicalPath() ).toStdString() ) )
+      deferredSoundDirs.push_back( soundDir );
+
+  soundDirs = deferredSoundDirs;
+}
+
 void LoadDictionaries::run()
 {
   try
   {
-    for(const auto & path : paths)
+    for( const auto & path : paths )
+    {
       handlePath( path );
 
+      if( isInterruptionRequested() )
+        return;
+    }
+
     // Make soundDirs
     {
       vector< sptr< Dictionary::Class > > soundDirDictionaries =
@@ -89,9 +116,15 @@ void LoadDictionaries::run()
 
       dictionaries.insert( dictionaries.end(), soundDirDictionaries.begin(),
                            soundDirDictionaries.end() );
+
+      if ( !onlyFiles.empty() )
+        for( auto const & dictionary : soundDirDictionaries )
+          emit dictionaryLoaded( dictionary );
     }
 
-    // Make hunspells
+    // Make hunspells, unless loading just the deferred dictionaries, since
+    // these have no indices
+    if ( onlyFiles.empty() )
     {
       vector< sptr< Dictionary::Class > > hunspellDictionaries =
         HunspellMorpho::makeDictionaries( hunspell );
@@ -134,9 +167,52 @@ void LoadDictionaries::handlePath( Config::Path const & path )
     }
 
     if ( !i->isDir() )
-      allFiles.push_back( QDir::toNativeSeparators( fullName ).toStdString() );
+    {
+      string fileName = QDir::toNativeSeparators( fullName ).toStdString();
+
+      if ( onlyFiles.empty() || onlyFiles.count( fileName ) )
+        allFiles.push_back( fileName );
+    }
+  }
+
+  if ( allFiles.empty() )
+    return;
+
+  if ( deferredDictionaries.empty() )
+  {
+    handleFiles( allFiles );
+    return;
   }
 
+  // One deferred dictionary at a time, so each is handed over once it's
+  // ready rather than after all the others
+  for( auto const & deferred : deferredDictionaries )
+  {
+    vector< string > files;
+
+    for( auto const & fileName : allFiles )
+      if ( std::find( deferred.begin(), deferred.end(), fileName ) != deferred.end() )
+        files.push_back( fileName );
+
+    if ( files.empty() )
+      continue;
+
+    size_t const loaded = dictionaries.size();
+
+    handleFiles( files );
+
+    for( size_t x = loaded; x < dictionaries.size(); ++x )
+      emit dictionaryLoaded( dictionaries[ x ] );
+
+    if ( isInterruptionRequested() )
+      return;
+  }
+}
+
+void LoadDictionaries::handleFiles( vector< string > const & allFiles )
+{
+  size_t const loaded = dictionaries.size();
+
   addDicts( Bgl::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
   addDicts( Stardict::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxHeadwordToExpand ) );
   addDicts( Lsa::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
@@ -149,6 +225,7 @@ void LoadDictionaries::handlePath( Config::Path const & path )
   addDicts( ZipSounds::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
   addDicts( Mdx::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
   addDicts( Gls::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
+  addDicts( Gdc::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this ) );
 
 #ifdef MAKE_ZIM_SUPPORT
   addDicts( Zim::makeDictionaries( allFiles, Config::getIndexDir().toStdString(), *this, maxHeadwordToExpand ) );
@@ -159,7 +236,8 @@ void LoadDictionaries::handlePath( Config::Path const & path )
 #endif
 
   //handle the custom dictionary name
-  for ( const auto & dict : dictionaries ) {
+  for ( size_t x = loaded; x < dictionaries.size(); ++x ) {
+    auto const & dict = dictionaries[ x ];
     auto baseDir = dict->getContainingFolder();
     if ( baseDir.isEmpty() )
       continue;
@@ -178,12 +256,21 @@ void LoadDictionaries::indexingDictionary( string const & dictionaryName ) noexc
   emit indexingDictionarySignal( QString::fromUtf8( dictionaryName.c_str() ) );
 }
 
+bool LoadDictionaries::isIndexingDeferred( vector< string > const & dictionaryFiles ) noexcept
+{
+  if ( deferIndexing )
+    deferredDictionaries.push_back( dictionaryFiles );
+
+  return deferIndexing;
+}
+
 
 void loadDictionaries( QWidget * parent, bool showInitially,
                        Config::Class const & cfg,
                        std::vector< sptr< Dictionary::Class > > & dictionaries,
                        QNetworkAccessManager & dictNetMgr,
-                       bool doDeferredInit_ )
+                       bool doDeferredInit_,
+                       vector< vector< string > > * deferredDictionaries )
 {
   dictionaries.clear();
 
@@ -191,7 +278,7 @@ void loadDictionaries( QWidget * parent, bool showInitially,
 
   // Start a thread to load all the dictionaries
 
-  LoadDictionaries loadDicts( cfg );
+  LoadDictionaries loadDicts( cfg, deferredDictionaries != nullptr );
 
   QObject::connect( &loadDicts, &LoadDictionaries::indexingDictionarySignal, &init, &Initializing::indexing );
 
@@ -213,11 +300,14 @@ void loadDictionaries( QWidget * parent, bool showInitially,
     return;
   }
 
+  if ( deferredDictionaries )
+    *deferredDictionaries = loadDicts.getDeferredDictionaries();
+
   dictionaries = loadDicts.getDictionaries();
 
   // Helper function that will add a vector of dictionary::Class to the dictionary list
   // Implemented as lambda to access method's `dictionaries` variable
-  auto  static addDicts = [&dictionaries](const vector< sptr< Dictionary::Class >> &dicts) {
+  auto addDicts = [&dictionaries](const vector< sptr< Dictionary::Class >> &dicts) {
     std::move(dicts.begin(), dicts.end(), std::back_inserter(dictionaries));
   };
 
@@ -259,8 +349,6 @@ void loadDictionaries( QWidget * parent, bool showInitially,
 
   GD_DPRINTF( "Load done\n" );
 
-  // Remove any stale index files
-
   set< string > ids;
   std::pair< std::set< string >::iterator, bool > ret;
 
@@ -278,9 +366,15 @@ void loadDictionaries( QWidget * parent, bool showInitially,
     }
   }
 
+  // Remove any stale index files. If some dictionaries were left out for now,
+  // their old indices are kept, as they may still be updated incrementally.
+
   QDir indexDir( Config::getIndexDir() );
 
-  QStringList allIdxFiles = indexDir.entryList( QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks );
+  QStringList allIdxFiles;
+
+  if ( loadDicts.getDeferredDictionaries().empty() )
+    allIdxFiles = indexDir.entryList( QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks );
 
   for( const auto & file : allIdxFiles)
   {
@@ -11,25 +11,40 @@
 #include <QThread>
 #include <QNetworkAccessManager>
 
+#include <set>
+
 /// Use loadDictionaries() function below -- this is a helper thread class
 class LoadDictionaries: public QThread, public Dictionary::Initializing
 {
   Q_OBJECT
 
   QStringList nameFilters;
-  Config::Paths const & paths;
-  Config::SoundDirs const & soundDirs;
-  Config::Hunspell const & hunspell;
-  Config::Transliteration const & transliteration;
+  // Copies, since the configuration may change while loading in background
+  Config::Paths paths;
+  Config::SoundDirs soundDirs;
+  Config::Hunspell hunspell;
+  Config::Transliteration transliteration;
   std::vector< sptr< Dictionary::Class > > dictionaries;
   std::string exceptionText;
   int maxPictureWidth;
   unsigned int maxHeadwordSize;
   unsigned int maxHeadwordToExpand;
+  bool deferIndexing;
+  std::vector< std::vector< std::string > > deferredDictionaries;
+  std::set< std::string > onlyFiles;
 
 public:
 
-  LoadDictionaries( Config::Class const & cfg );
+  /// If deferIndexing is true, the dictionaries whose indices need building
+  /// are skipped rather than indexed, see getDeferredDictionaries().
+  LoadDictionaries( Config::Class const & cfg, bool deferIndexing = false );
+
+  /// Only loads the given dictionaries, each given by its files, which are
+  /// the ones a deferring load skipped. Their indices get built, one after
+  /// another, and dictionaryLoaded() is emitted as each gets ready.
+  /// Requesting the interruption of the thread cancels the indexing.
+  LoadDictionaries( Config::Class const & cfg,
+                    std::vector< std::vector< std::string > > const & deferredDictionaries );
 
   virtual void run();
 
@@ -40,21 +55,35 @@ public:
   std::string const & getExceptionText() const
   { return exceptionText; }
 
+  /// Returns the files of each dictionary which was skipped since its
+  /// index needed building
+  std::vector< std::vector< std::string > > const & getDeferredDictionaries() const
+  { return deferredDictionaries; }
+
 
 
 public:
 
   virtual void indexingDictionary( std::string const & dictionaryName ) noexcept;
 
+  virtual bool isIndexingDeferred( std::vector< std::string > const & dictionaryFiles ) noexcept;
+
 private:
 
   void handlePath( Config::Path const & );
 
+  /// Makes the dictionaries out of the given files of a single directory
+  void handleFiles( std::vector< std::string > const & );
+
   // Helper function that will add a vector of dictionary::Class to the dictionary list
   void addDicts(const std::vector< sptr< Dictionary::Class > >& dicts);
 
 signals:
   void indexingDictionarySignal( QString const & dictionaryName );
+
+  /// Emitted when loading just the deferred dictionaries, for each of them
+  /// once it's ready, so it can be used before the others are
+  void dictionaryLoaded( sptr< Dictionary::Class > const & dictionary );
 };
 
 /// Loads all dictionaries mentioned in the configuration passed, into the
@@ -62,11 +91,15 @@ signals:
 /// If showInitially is passed as true, the window will always popup.
 /// If doDeferredInit is true (default), doDeferredInit() is done on all
 /// dictionaries at the end.
+/// If deferredDictionaries is given, the dictionaries which need indexing are
+/// left out and their files are put there, for the caller to load them later
+/// with a LoadDictionaries thread of its own.
 void loadDictionaries( QWidget * parent, bool showInitially,
                        Config::Class const & cfg,
                        std::vector< sptr< Dictionary::Class > > &,
                        QNetworkAccessManager & dictNetMgr,
-                       bool doDeferredInit = true );
+                       bool doDeferredInit = true,
+                       std::vector< std::vector< std::string > > * deferredDictionaries = nullptr );
 
 /// Runs deferredInit() on all the given dictionaries. Useful when
 /// loadDictionaries() was previously called with doDeferredInit = false.
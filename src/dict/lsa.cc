@@ -11,6 +11,8 @@
 #include "audiolink.hh"
 #include "gddebug.hh"
 
+#include <algorithm>
+#include <memory>
 #include <set>
 #include <string>
 
@@ -20,6 +22,7 @@
 
 #define OV_EXCLUDE_STATIC_CALLBACKS
 #include <vorbis/vorbisfile.h>
+#include <QCache>
 #include <QDir>
 #include <QUrl>
 #include <QFile>
@@ -47,7 +50,7 @@ DEF_EX( exFailedToRetrieveVorbisInfo, "Failed to retrieve Vorbis info", Dictiona
 enum
 {
   Signature = 0x5841534c, // LSAX on little-endian, XASL on big-endian
-  CurrentFormatVersion = 5
+  CurrentFormatVersion = 6
 };
 
 struct IdxHeader
@@ -58,12 +61,29 @@ struct IdxHeader
   uint32_t vorbisOffset; // Offset of the vorbis file which contains all snds
   uint32_t indexBtreeMaxElements; // Two fields from IndexInfo
   uint32_t indexRootOffset;
+  uint32_t entriesOffset; // Offset of the EntryPosition table
+  uint32_t entriesCount; // Number of records in that table
 } 
 #ifndef _MSC_VER
 __attribute__((packed))
 #endif
 ;
 
+/// Where the sound of an entry lies within the vorbis stream. The table of
+/// these is sorted by entryOffset, which is what the btree links point to.
+struct EntryPosition
+{
+  uint32_t entryOffset; // Offset of the entry in the .lsa file
+  uint32_t samplesOffset;
+  uint32_t samplesLength;
+  uint32_t pageOffset; // Offset of an Ogg page, relative to the start of the
+                       // vorbis stream, to start decoding from. 0 if unknown
+}
+#ifndef _MSC_VER
+__attribute__((packed))
+#endif
+;
+
 bool indexIsOldOrBad( string const & indexFile )
 {
   File::Class idx( indexFile, "rb" );
@@ -152,17 +172,37 @@ Entry::Entry( File::Class & f )
                         read * sizeof( uint16_t ) );
 }
 
+struct VorbisStream;
+
 class LsaDictionary: public BtreeIndexing::BtreeDictionary
 {
   QMutex idxMutex;
   File::Class idx;
   IdxHeader idxHeader;
+  vector< EntryPosition > entries;
+
+  /// Opened vorbis streams nobody decodes from at the moment. Each has its
+  /// own file handle, so several sounds can be decoded at once.
+  QMutex streamsMutex;
+  vector< std::unique_ptr< VorbisStream > > idleStreams;
+
+  /// Recently decoded sounds, keyed by entry offsets
+  QMutex decodedSoundsMutex;
+  QCache< uint32_t, vector< char > > decodedSounds;
+
+  enum
+  {
+    MaxIdleStreams = 4,
+    MaxDecodedSoundsKb = 16 * 1024
+  };
 
 public:
 
   LsaDictionary( string const & id, string const & indexFile,
                  vector< string > const & dictionaryFiles );
 
+  ~LsaDictionary() override;
+
   string getName() noexcept override;
 
   map< Dictionary::Property, string > getProperties() noexcept override
@@ -186,6 +226,13 @@ public:
 protected:
 
   void loadIcon() noexcept override;
+
+private:
+
+  EntryPosition const & findEntry( uint32_t entryOffset ) const;
+
+  std::unique_ptr< VorbisStream > takeStream();
+  void returnStream( std::unique_ptr< VorbisStream > stream );
 };
 
 string LsaDictionary::getName() noexcept
@@ -203,8 +250,19 @@ LsaDictionary::LsaDictionary( string const & id,
                               vector< string > const & dictionaryFiles ):
   BtreeDictionary( id, dictionaryFiles ),
   idx( indexFile, "rb" ),
-  idxHeader( idx.read< IdxHeader >() )
+  idxHeader( idx.read< IdxHeader >() ),
+  decodedSounds( MaxDecodedSoundsKb )
 {
+  // Load the entry positions
+
+  entries.resize( idxHeader.entriesCount );
+
+  if ( !entries.empty() )
+  {
+    idx.seek( idxHeader.entriesOffset );
+    idx.read( &entries.front(), entries.size() * sizeof( EntryPosition ) );
+  }
+
   // Initialize the index
 
   openIndex( IndexInfo( idxHeader.indexBtreeMaxElements,
@@ -212,6 +270,18 @@ LsaDictionary::LsaDictionary( string const & id,
              idx, idxMutex );
 }
 
+EntryPosition const & LsaDictionary::findEntry( uint32_t entryOffset ) const
+{
+  auto i = std::lower_bound( entries.begin(), entries.end(), entryOffset,
+                             []( EntryPosition const & e, uint32_t offset )
+                             { return e.entryOffset < offset; } );
+
+  if ( i == entries.end() || i->entryOffset != entryOffset )
+    throw exInvalidData();
+
+  return *i;
+}
+
 sptr< Dictionary::DataRequest > LsaDictionary::getArticle( wstring const & word,
                                                            vector< wstring > const & alts,
                                                            wstring const &,
@@ -376,6 +446,157 @@ ov_callbacks ShiftedVorbis::callbacks = { ShiftedVorbis::read,
                                           NULL,
                                           ShiftedVorbis::tell };
 
+/// A vorbis stream opened on its own handle of the .lsa file
+struct VorbisStream
+{
+  File::Class f;
+  ShiftedVorbis sv;
+  OggVorbis_File vf;
+
+  VorbisStream( string const & fileName, uint32_t vorbisOffset );
+
+  ~VorbisStream()
+  { ov_clear( &vf ); }
+};
+
+VorbisStream::VorbisStream( string const & fileName, uint32_t vorbisOffset ):
+  f( fileName, "rb" ),
+  sv( f.file(), vorbisOffset )
+{
+  f.seek( vorbisOffset );
+
+  if ( ov_open_callbacks( &sv, &vf, 0, 0, ShiftedVorbis::callbacks ) )
+    throw exFailedToOpenVorbisData();
+}
+
+LsaDictionary::~LsaDictionary()
+{
+}
+
+std::unique_ptr< VorbisStream > LsaDictionary::takeStream()
+{
+  {
+    QMutexLocker _( &streamsMutex );
+
+    if ( !idleStreams.empty() )
+    {
+      std::unique_ptr< VorbisStream > stream = std::move( idleStreams.back() );
+      idleStreams.pop_back();
+      return stream;
+    }
+  }
+
+  return std::make_unique< VorbisStream >( getDictionaryFilenames()[ 0 ],
+                                           idxHeader.vorbisOffset );
+}
+
+void LsaDictionary::returnStream( std::unique_ptr< VorbisStream > stream )
+{
+  QMutexLocker _( &streamsMutex );
+
+  if ( idleStreams.size() < MaxIdleStreams )
+    idleStreams.push_back( std::move( stream ) );
+}
+
+/// Decodes and throws away the given number of samples
+bool skipSamples( OggVorbis_File & vf, ogg_int64_t samples, int channels )
+{
+  char buf[ 8192 ];
+  ogg_int64_t left = samples * channels * 2;
+  int bitstream = 0;
+
+  while( left > 0 )
+  {
+    long result = ov_read( &vf, buf, std::min< ogg_int64_t >( left, sizeof( buf ) ),
+                           0, 2, 1, &bitstream );
+
+    if ( result <= 0 )
+      return false;
+
+    left -= result;
+  }
+
+  return true;
+}
+
+/// Positions the stream at the first sample of the entry. Decoding starts
+/// from the entry's page when it is known; otherwise, or if that page turns
+/// out to be wrong, vorbisfile bisects the stream to find it.
+void seekToEntry( OggVorbis_File & vf, EntryPosition const & entry )
+{
+  if ( entry.pageOffset && ov_raw_seek( &vf, entry.pageOffset ) == 0 )
+  {
+    ogg_int64_t pcmOffset = ov_pcm_tell( &vf );
+    vorbis_info * vi = ov_info( &vf, -1 );
+
+    if ( vi && pcmOffset >= 0 && pcmOffset <= entry.samplesOffset &&
+         skipSamples( vf, entry.samplesOffset - pcmOffset, vi->channels ) )
+      return;
+  }
+
+  if ( ov_pcm_seek( &vf, entry.samplesOffset ) )
+    throw exFailedToSeekInVorbisData();
+}
+
+/// Finds, for every entry, an Ogg page to start decoding its sound from: the
+/// last page which ends before the entry's first sample. The stream is
+/// scanned once, and pages are told apart by their granule positions.
+void findPageOffsets( File::Class & f, uint32_t vorbisOffset,
+                      vector< EntryPosition > & entries )
+{
+  vector< std::pair< ogg_int64_t, ogg_int64_t > > pages; // offset, granulepos
+
+  f.seek( vorbisOffset );
+
+  ogg_sync_state oy;
+  ogg_sync_init( &oy );
+
+  ogg_int64_t offset = 0;
+
+  for( ; ; )
+  {
+    ogg_page og;
+
+    long result = ogg_sync_pageseek( &oy, &og );
+
+    if ( result > 0 )
+    {
+      ogg_int64_t granulePos = ogg_page_granulepos( &og );
+
+      if ( granulePos >= 0 )
+        pages.emplace_back( offset, granulePos );
+
+      offset += result;
+    }
+    else
+    if ( result < 0 )
+      offset -= result; // Skipped some garbage
+    else
+    {
+      char * buffer = ogg_sync_buffer( &oy, 65536 );
+
+      qint64 read = f.file().read( buffer, 65536 );
+
+      if ( read <= 0 )
+        break;
+
+      ogg_sync_wrote( &oy, read );
+    }
+  }
+
+  ogg_sync_clear( &oy );
+
+  for( auto & entry : entries )
+  {
+    auto i = std::lower_bound( pages.begin(), pages.end(), (ogg_int64_t)entry.samplesOffset,
+                               []( std::pair< ogg_int64_t, ogg_int64_t > const & page,
+                                   ogg_int64_t samples )
+                               { return page.second < samples; } );
+
+    entry.pageOffset = i == pages.begin() ? 0 : ( i - 1 )->first;
+  }
+}
+
 // A crude .wav header which is sufficient for our needs
 struct WavHeader
 {
@@ -411,38 +632,33 @@ sptr< Dictionary::DataRequest > LsaDictionary::getResource( string const & name
   if ( chain.empty() )
     return std::make_shared<Dictionary::DataRequestInstant>( false ); // No such resource
 
-  File::Class f( getDictionaryFilenames()[ 0 ], "rb" );
+  EntryPosition const & e = findEntry( chain[ 0 ].articleOffset );
 
-  f.seek( chain[ 0 ].articleOffset );
-  Entry e( f );
+  sptr< Dictionary::DataRequestInstant > dr = std::make_shared<
+    Dictionary::DataRequestInstant>( true );
 
-  f.seek( idxHeader.vorbisOffset );
+  vector< char > & data = dr->getData();
 
-  ShiftedVorbis sv( f.file(), idxHeader.vorbisOffset );
+  {
+    QMutexLocker _( &decodedSoundsMutex );
 
-  OggVorbis_File vf;
+    if ( vector< char > * decoded = decodedSounds.object( e.entryOffset ) )
+    {
+      data = *decoded;
+      return dr;
+    }
+  }
 
-  int result = ov_open_callbacks( &sv, &vf, 0, 0, ShiftedVorbis::callbacks );
+  std::unique_ptr< VorbisStream > stream = takeStream();
 
-  if ( result )
-    throw exFailedToOpenVorbisData();
+  OggVorbis_File & vf = stream->vf;
 
-  if ( ov_pcm_seek( &vf, e.samplesOffset ) )
-    throw exFailedToSeekInVorbisData();
+  seekToEntry( vf, e );
 
   vorbis_info * vi = ov_info( &vf, -1 );
 
   if ( !vi )
-  {
-    ov_clear( &vf );
-
     throw exFailedToRetrieveVorbisInfo();
-  }
-
-  sptr< Dictionary::DataRequestInstant > dr = std::make_shared<
-    Dictionary::DataRequestInstant>( true );
-
-  vector< char > & data = dr->getData();
 
   data.resize( sizeof( WavHeader ) + e.samplesLength * 2 );
 
@@ -492,7 +708,14 @@ sptr< Dictionary::DataRequest > LsaDictionary::getResource( string const & name
     left -= result;
   }
 
-  ov_clear( &vf );
+  returnStream( std::move( stream ) );
+
+  {
+    QMutexLocker _( &decodedSoundsMutex );
+
+    decodedSounds.insert( e.entryOffset, new vector< char >( data ),
+                          std::max< size_t >( data.size() / 1024, 1 ) );
+  }
 
   return dr;
 }
@@ -558,13 +781,16 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         // Building the index
 
         gdDebug( "Lsa: Building the index for dictionary: %s\n", i->c_str() );
 
         initializing.indexingDictionary( Utils::Fs::basename( *i ) );
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
 
         IdxHeader idxHeader;
 
@@ -586,6 +812,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
         vector< uint16_t > filenameBuffer;
 
+        vector< EntryPosition > entries;
+        entries.reserve( entriesCount );
+
         while( entriesCount-- )
         {
           uint32_t offset = f.tell();
@@ -601,6 +830,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           // Insert new entry into an index
 
           indexedWords.addWord( Utf8::decode( e.name ), offset );
+
+          entries.push_back( EntryPosition{ offset, e.samplesOffset, e.samplesLength, 0 } );
         }
 
         idxHeader.vorbisOffset = f.tell();
@@ -614,6 +845,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         if ( strncmp( buf, "OggS", 4 ) != 0 )
           throw exInvalidData();
 
+        findPageOffsets( f, idxHeader.vorbisOffset, entries );
+
         // Build the index
 
         IndexInfo idxInfo = BtreeIndexing::buildIndex( indexedWords, idx );
@@ -621,6 +854,14 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idxHeader.indexBtreeMaxElements = idxInfo.btreeMaxElements;
         idxHeader.indexRootOffset = idxInfo.rootOffset;
 
+        // Entries lie in the file in order, so the table is sorted already
+
+        idxHeader.entriesOffset = idx.tell();
+        idxHeader.entriesCount = entries.size();
+
+        if ( !entries.empty() )
+          idx.write( &entries.front(), entries.size() * sizeof( EntryPosition ) );
+
          // That concludes it. Update the header.
 
         idxHeader.signature = Signature;
@@ -629,6 +870,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.rewind();
 
         idx.write( &idxHeader, sizeof( idxHeader ) );
+        idx.commit();
+        Dictionary::indexBuilt( dictFiles, indexFile );
       }
 
       dictionaries.push_back( std::make_shared<LsaDictionary>( dictId,
@@ -238,6 +238,15 @@ bool MdictParser::parseCompressedBlock( qint64 compressedBlockSize,
     case 0x01000000:
       {
         // LZO compression
+
+        // The output is allocated up front, so a corrupt size mustn't make
+        // for a huge allocation. LZO can't expand data over 255 times or so.
+        if ( decompressedBlockSize < 0 || decompressedBlockSize > size * 256 + 4096 )
+        {
+          gdWarning( "MDict: parseCompressedBlock: lzo: bad decompressed size" );
+          return false;
+        }
+
         int result;
         lzo_uint blockSize = ( lzo_uint )decompressedBlockSize;
         decompressedBlock.resize( blockSize );
@@ -262,8 +271,9 @@ bool MdictParser::parseCompressedBlock( qint64 compressedBlockSize,
       break;
 
     case 0x02000000:
-      // zlib compression
-      decompressedBlock = zlibDecompress( buf, size );
+      // zlib compression. The size is only a hint, which zlibDecompress()
+      // doesn't trust beyond what the data could expand to.
+      decompressedBlock = zlibDecompress( buf, size, decompressedBlockSize > 0 ? decompressedBlockSize : 0 );
 
       if ( !checkAdler32( decompressedBlock.constData(), decompressedBlock.size(),
                           checksum ) )
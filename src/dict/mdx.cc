@@ -59,7 +59,7 @@ using namespace Mdict;
 enum
 {
   kSignature = 0x4349444d,  // MDIC
-  kCurrentFormatVersion = 11 + BtreeIndexing::FormatVersion + Folding::Version
+  kCurrentFormatVersion = 11 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 DEF_EX( exCorruptDictionary, "dictionary file was tampered or corrupted", std::exception )
@@ -1353,6 +1353,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
     string indexFile = indicesDir + dictId;
 
     if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( dictFiles, indexFile ) ) {
+      if ( initializing.isIndexingDeferred( dictFiles ) )
+        continue; // It will be built in the background
+
       // Building the index
 
       gdDebug( "MDict: Building the index for dictionary: %s\n", fileName.c_str() );
@@ -1381,7 +1384,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
         }
       }
 
-      File::Class idx( indexFile, "wb" );
+      File::Replacement idx( indexFile );
       IdxHeader idxHeader;
       memset( &idxHeader, 0, sizeof( idxHeader ) );
       // We write a dummy header first. At the end of the process the header
@@ -1405,7 +1408,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
       // This map maps folded words to the original words and the corresponding
       // articles' offsets.
       IndexedWords indexedWords;
-      ChunkedStorage::Writer chunks( idx );
+      ChunkedStorage::Writer chunks( idx, ChunkedStorage::SmallBlocksChunkSize );
 
       idxHeader.isRightToLeft = parser.isRightToLeft();
 
@@ -1520,6 +1523,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
 
       idx.rewind();
       idx.write( &idxHeader, sizeof( idxHeader ) );
+      idx.commit();
+      Dictionary::indexBuilt( dictFiles, indexFile );
     }
 
     dictionaries.push_back( std::make_shared<MdxDictionary>( dictId, indexFile, dictFiles ) );
@@ -88,7 +88,7 @@ __attribute__((packed))
 enum
 {
   Signature = 0x43494453, // SDIC on little-endian, CIDS on big-endian
-  CurrentFormatVersion = 1 + BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 1 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 struct IdxHeader
@@ -734,6 +734,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         try
         {
           gdDebug( "SDict: Building the index for dictionary: %s\n", i->c_str() );
@@ -769,7 +772,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
           initializing.indexingDictionary( dictName );
 
-          File::Class idx( indexFile, "wb" );
+          File::Replacement idx( indexFile );
           IdxHeader idxHeader;
           memset( &idxHeader, 0, sizeof( idxHeader ) );
 
@@ -839,6 +842,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           idx.rewind();
 
           idx.write( &idxHeader, sizeof( idxHeader ) );
+          idx.commit();
+          Dictionary::indexBuilt( dictFiles, indexFile );
         }
         catch( std::exception & e )
         {
@@ -1479,6 +1479,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
              indexIsOldOrBad( indexFile ) )
         {
+          if ( initializing.isIndexingDeferred( dictFiles ) )
+            continue; // It will be built in the background
+
           SlobFile sf;
 
           gdDebug( "Slob: Building the index for dictionary: %s\n", i->c_str() );
@@ -1487,7 +1490,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
           initializing.indexingDictionary( sf.getDictionaryName().toUtf8().constData() );
 
-          File::Class idx( indexFile, "wb" );
+          File::Replacement idx( indexFile );
           IdxHeader idxHeader;
           memset( &idxHeader, 0, sizeof( idxHeader ) );
 
@@ -1574,6 +1577,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           idx.rewind();
 
           idx.write( &idxHeader, sizeof( idxHeader ) );
+          idx.commit();
+          Dictionary::indexBuilt( dictFiles, indexFile );
 
         }
         dictionaries.push_back(std::make_shared<SlobDictionary>( dictId,
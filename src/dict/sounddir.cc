@@ -14,9 +14,13 @@
 
 #include "utils.hh"
 
+#include <atomic>
 #include <set>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
+#include <QtConcurrent>
 
 namespace SoundDir {
 
@@ -34,7 +38,7 @@ namespace {
 enum
 {
   Signature = 0x58524453, // SDRX on little-endian, XRDS on big-endian
-  CurrentFormatVersion = 1+ BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 2 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 struct IdxHeader
@@ -45,6 +49,7 @@ struct IdxHeader
   uint32_t chunksOffset; // The offset to chunks' storage
   uint32_t indexBtreeMaxElements; // Two fields from IndexInfo
   uint32_t indexRootOffset;
+  uint32_t dirStatesOffset; // The offset to the compressed DirStates
 } 
 #ifndef _MSC_VER
 __attribute__((packed))
@@ -62,6 +67,29 @@ bool indexIsOldOrBad( string const & indexFile )
          header.formatVersion != CurrentFormatVersion;
 }
 
+/// The state of one directory of the sound dir as of the last indexing.
+/// These are stored in the index, so that a rescan only needs to list the
+/// directories which have changed since.
+struct DirState
+{
+  QString path; // Relative to the sound dir, empty for the sound dir itself
+  qint64 lastModified = 0; // Msecs since epoch, -1 if the dir is gone
+  QStringList subdirs; // Names of the subdirectories
+  QStringList sounds; // Names of the sound files
+};
+
+QDataStream & operator<<( QDataStream & out, DirState const & state )
+{
+  return out << state.path << state.lastModified << state.subdirs << state.sounds;
+}
+
+QDataStream & operator>>( QDataStream & in, DirState & state )
+{
+  return in >> state.path >> state.lastModified >> state.subdirs >> state.sounds;
+}
+
+using DirStates = QHash< QString, DirState >;
+
 class SoundDirDictionary: public BtreeIndexing::BtreeDictionary
 {
   string name;
@@ -368,27 +396,165 @@ sptr< Dictionary::DataRequest > SoundDirDictionary::getResource( string const &
   }
 }
 
-void addDir( QDir const & baseDir, QDir const & dir, IndexedWords & indexedWords,
-             uint32_t & soundsCount, ChunkedStorage::Writer & chunks )
+/// Reads the dir states stored in the index. Returns false if they can't be
+/// read, in which case the index has to be built from scratch.
+bool loadDirStates( string const & indexFile, DirStates & states )
 {
-  QFileInfoList entries = dir.entryInfoList( QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot );
+  try
+  {
+    File::Class idx( indexFile, "rb" );
+
+    IdxHeader header = idx.read< IdxHeader >();
+
+    idx.seek( header.dirStatesOffset );
+
+    uint32_t size = idx.read< uint32_t >();
+
+    QByteArray compressed( size, '\0' );
+
+    idx.read( compressed.data(), compressed.size() );
+
+    QByteArray data = qUncompress( compressed );
+    QDataStream in( data );
+
+    quint32 count = 0;
+    in >> count;
+
+    for( quint32 x = 0; x < count && in.status() == QDataStream::Ok; ++x )
+    {
+      DirState state;
+      in >> state;
+      states.insert( state.path, state );
+    }
+
+    return in.status() == QDataStream::Ok;
+  }
+  catch( std::exception & )
+  {
+    return false;
+  }
+}
+
+void saveDirStates( File::Class & idx, DirStates const & states )
+{
+  QByteArray data;
+
+  {
+    QDataStream out( &data, QIODevice::WriteOnly );
+
+    out << (quint32)states.size();
+
+    for( auto const & state : states )
+      out << state;
+  }
+
+  QByteArray compressed = qCompress( data );
+
+  idx.write< uint32_t >( compressed.size() );
+  idx.write( compressed.data(), compressed.size() );
+}
+
+/// Fills in the given state, whose path is set. The directory is only listed
+/// if its modification time differs from the one in oldStates, otherwise its
+/// contents are taken from there. Returns true if the directory was listed.
+bool updateDirState( QDir const & baseDir, DirState & state, DirStates const & oldStates )
+{
+  QFileInfo info( state.path.isEmpty() ? baseDir.path() : baseDir.filePath( state.path ) );
+
+  if ( !info.isDir() )
+  {
+    state.lastModified = -1;
+    return true;
+  }
+
+  state.lastModified = info.lastModified().toMSecsSinceEpoch();
+
+  DirStates::const_iterator old = oldStates.constFind( state.path );
+
+  if ( old != oldStates.constEnd() && old->lastModified == state.lastModified )
+  {
+    state.subdirs = old->subdirs;
+    state.sounds = old->sounds;
+    return false;
+  }
+
+  QFileInfoList entries =
+    QDir( info.filePath() ).entryInfoList( QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot );
 
   for( QFileInfoList::const_iterator i = entries.constBegin();
        i != entries.constEnd(); ++i )
   {
     if ( i->isDir() )
-      addDir( baseDir, QDir( i->absoluteFilePath() ), indexedWords, soundsCount, chunks );
+      state.subdirs.append( i->fileName() );
     else
     if ( Filetype::isNameOfSound( i->fileName().toUtf8().data() ) )
+      state.sounds.append( i->fileName() );
+  }
+
+  return true;
+}
+
+/// Collects the states of all the directories of the sound dir into states.
+/// The tree is walked level by level, the directories of each level being
+/// scanned in parallel. Returns true if anything has changed compared to
+/// oldStates.
+bool scanSoundDir( QDir const & baseDir, DirStates const & oldStates, DirStates & states )
+{
+  std::atomic< bool > changed( false );
+
+  QVector< DirState > level( 1 ); // Starting with the sound dir itself
+
+  while( !level.isEmpty() )
+  {
+    QtConcurrent::blockingMap( level, [ & ]( DirState & state ) {
+      if ( updateDirState( baseDir, state, oldStates ) )
+        changed = true;
+    } );
+
+    QVector< DirState > nextLevel;
+
+    for( auto const & state : level )
+    {
+      if ( state.lastModified < 0 )
+        continue; // Removed while scanning
+
+      for( auto const & subdir : state.subdirs )
+      {
+        DirState subdirState;
+        subdirState.path = state.path.isEmpty() ? subdir : state.path + '/' + subdir;
+        nextLevel.append( subdirState );
+      }
+
+      states.insert( state.path, state );
+    }
+
+    level.swap( nextLevel );
+  }
+
+  return changed || states.size() != oldStates.size();
+}
+
+void addSounds( DirStates const & states, IndexedWords & indexedWords,
+                uint32_t & soundsCount, ChunkedStorage::Writer & chunks )
+{
+  QStringList paths = states.keys();
+
+  paths.sort();
+
+  for( auto const & path : paths )
+  {
+    QStringList const sounds = states.value( path ).sounds;
+
+    for( auto const & sound : sounds )
     {
       // Add this sound to index
 
-      string fileName = baseDir.relativeFilePath( i->filePath() ).toUtf8().data();
+      string fileName = ( path.isEmpty() ? sound : path + '/' + sound ).toUtf8().data();
 
       uint32_t articleOffset = chunks.startNewBlock();
       chunks.addToBlock( fileName.c_str(), fileName.size() + 1 );
 
-      wstring name = gd::toWString( i->fileName() );
+      wstring name = gd::toWString( sound );
 
       wstring::size_type pos = name.rfind( L'.' );
 
@@ -429,15 +595,33 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::SoundDirs const &
 
     string indexFile = indicesDir + dictId;
 
-    if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile ) )
+    DirStates oldStates, states;
+
+    bool fullRebuild = Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile )
+                       || !loadDirStates( indexFile, oldStates );
+
+    if ( fullRebuild && initializing.isIndexingDeferred( dictFiles ) )
+      continue; // It will be built in the background
+
+    if ( fullRebuild )
+      initializing.indexingDictionary( i->name.toUtf8().data() );
+
+    // Only the directories changed since the last indexing get listed here,
+    // so an up-to-date index costs one stat per directory
+
+    if ( scanSoundDir( dir, oldStates, states ) || fullRebuild )
     {
+      if ( initializing.isIndexingDeferred( dictFiles ) )
+        continue; // It will be built in the background
+
       // Building the index
 
       qDebug() << "Sounds: Building the index for directory: " << i->path;
 
-      initializing.indexingDictionary( i->name.toUtf8().data() );
+      if ( !fullRebuild )
+        initializing.indexingDictionary( i->name.toUtf8().data() );
 
-      File::Class idx( indexFile, "wb" );
+      File::Replacement idx( indexFile );
 
       IdxHeader idxHeader;
 
@@ -450,11 +634,11 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::SoundDirs const &
 
       IndexedWords indexedWords;
 
-      ChunkedStorage::Writer chunks( idx );
+      ChunkedStorage::Writer chunks( idx, ChunkedStorage::SmallBlocksChunkSize );
 
       uint32_t soundsCount = 0; // Header's one is packed, we can't ref it
 
-      addDir( dir, dir, indexedWords, soundsCount, chunks );
+      addSounds( states, indexedWords, soundsCount, chunks );
 
       idxHeader.soundsCount = soundsCount;
 
@@ -469,6 +653,12 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::SoundDirs const &
       idxHeader.indexBtreeMaxElements = idxInfo.btreeMaxElements;
       idxHeader.indexRootOffset = idxInfo.rootOffset;
 
+      // Store the dir states for the next rescan
+
+      idxHeader.dirStatesOffset = idx.tell();
+
+      saveDirStates( idx, states );
+
        // That concludes it. Update the header.
 
       idxHeader.signature = Signature;
@@ -477,6 +667,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::SoundDirs const &
       idx.rewind();
 
       idx.write( &idxHeader, sizeof( idxHeader ) );
+      idx.commit();
+      Dictionary::indexBuilt( dictFiles, indexFile );
     }
 
     dictionaries.push_back( std::make_shared<SoundDirDictionary>( dictId,
@@ -96,7 +96,7 @@ struct Ifo
 enum
 {
   Signature = 0x58444953, // SIDX on little-endian, XDIS on big-endian
-  CurrentFormatVersion = 9 + BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 9 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 struct IdxHeader
@@ -143,7 +143,6 @@ class StardictDictionary: public BtreeIndexing::BtreeDictionary
   ChunkedStorage::Reader chunks;
   QMutex dzMutex;
   dictData * dz;
-  QMutex resourceZipMutex;
   IndexedZip resourceZip;
 
 public:
@@ -1950,6 +1949,9 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         // Building the index
 
         File::Class ifoFile( *i, "r" );
@@ -1986,7 +1988,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
         initializing.indexingDictionary( ifo.bookname );
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
 
         IdxHeader idxHeader;
 
@@ -2002,7 +2004,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
         IndexedWords indexedWords;
 
-        ChunkedStorage::Writer chunks( idx );
+        ChunkedStorage::Writer chunks( idx, ChunkedStorage::SmallBlocksChunkSize );
 
         // Load indices
         if ( !ifo.synwordcount )
@@ -2096,6 +2098,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.rewind();
 
         idx.write( &idxHeader, sizeof( idxHeader ) );
+        idx.commit();
+        Dictionary::indexBuilt( dictFiles, indexFile );
       }
 
       dictionaries.push_back( std::make_shared<StardictDictionary>( dictId,
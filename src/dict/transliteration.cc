@@ -6,6 +6,8 @@
 #include "folding.hh"
 #include "gddebug.hh"
 
+#include <algorithm>
+
 namespace Transliteration {
 
 using gd::wchar;
@@ -64,11 +66,70 @@ void Table::ins( char const * from, char const * to )
 {
   wstring fr = Utf8::decode( std::string( from ) );
 
+  if ( fr.empty() )
+    return;
+
   if ( fr.size() > maxEntrySize )
     maxEntrySize = fr.size();
 
-  insert( std::pair< wstring, wstring >( fr,
-                                         Utf8::decode( std::string( to ) ) ) );
+  uint32_t node = 0;
+
+  for( wchar ch : fr )
+  {
+    auto & children = nodes[ node ].children;
+
+    auto i = std::lower_bound( children.begin(), children.end(), ch,
+                               []( std::pair< wchar, uint32_t > const & e, wchar c ) {
+                                 return e.first < c;
+                               } );
+
+    if ( i != children.end() && i->first == ch )
+      node = i->second;
+    else
+    {
+      uint32_t const child = nodes.size();
+      children.insert( i, std::make_pair( ch, child ) );
+      nodes.emplace_back(); // Invalidates children, which isn't used anymore
+      node = child;
+    }
+  }
+
+  // Like with a map, the first entry inserted wins
+  if ( nodes[ node ].replacement < 0 )
+  {
+    nodes[ node ].replacement = replacements.size();
+    replacements.push_back( Utf8::decode( std::string( to ) ) );
+  }
+}
+
+wstring const * Table::findLongestMatch( wchar const * str, size_t size,
+                                         size_t & matchedSize ) const
+{
+  wstring const * result = nullptr;
+  uint32_t node = 0;
+
+  for( size_t x = 0; x < size; ++x )
+  {
+    auto const & children = nodes[ node ].children;
+
+    auto i = std::lower_bound( children.begin(), children.end(), str[ x ],
+                               []( std::pair< wchar, uint32_t > const & e, wchar c ) {
+                                 return e.first < c;
+                               } );
+
+    if ( i == children.end() || i->first != str[ x ] )
+      break;
+
+    node = i->second;
+
+    if ( nodes[ node ].replacement >= 0 )
+    {
+      result = &replacements[ nodes[ node ].replacement ];
+      matchedSize = x + 1;
+    }
+  }
+
+  return result;
 }
 
 
@@ -104,29 +165,17 @@ vector< wstring > TransliterationDictionary::getAlternateWritings( wstring const
   wchar const * ptr = target->c_str();
   size_t left = target->size();
 
-  Table::const_iterator i;
-
   while( left )
   {
-    unsigned x;
+    size_t matchedSize;
 
-    for( x = table.getMaxEntrySize(); x >= 1; --x )
+    if ( wstring const * replacement = table.findLongestMatch( ptr, left, matchedSize ) )
     {
-      if ( left >= x )
-      {
-        i = table.find( wstring( ptr, x ) );
-
-        if ( i != table.end() )
-        {
-          result.append( i->second );
-          ptr += x;
-          left -= x;
-          break;
-        }
-      }
+      result.append( *replacement );
+      ptr += matchedSize;
+      left -= matchedSize;
     }
-
-    if ( !x )
+    else
     {
       // No matches -- add this char as it is
       result.push_back( *ptr++ );
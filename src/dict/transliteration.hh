@@ -52,18 +52,35 @@ public:
 };
 
 
-class Table: public map< wstring, wstring >
+/// A transliteration table. The entries are kept in a trie, so that the
+/// longest entry at any position of a string is found in one pass over it.
+class Table
 {
+  /// A trie node. Children are sorted by their characters.
+  struct Node
+  {
+    vector< std::pair< gd::wchar, uint32_t > > children;
+    int32_t replacement = -1; // Index in replacements, or -1 if no entry ends here
+  };
+
+  vector< Node > nodes; // nodes[ 0 ] is the root
+  vector< wstring > replacements;
   unsigned maxEntrySize;
 
 public:
 
-  Table(): maxEntrySize( 0 )
+  Table(): nodes( 1 ), maxEntrySize( 0 )
   {}
 
   unsigned getMaxEntrySize() const
   { return maxEntrySize; }
 
+  /// Finds the longest entry the given string starts with. Returns its
+  /// replacement and stores the entry's size to matchedSize, or returns
+  /// nullptr if there's no such entry.
+  wstring const * findLongestMatch( gd::wchar const * str, size_t size,
+                                    size_t & matchedSize ) const;
+
 protected:
 
   /// Inserts new entry into index. from and to are UTF8-encoded strings.
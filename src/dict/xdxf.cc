@@ -9,6 +9,9 @@
 #include "dictzip.hh"
 #include "htmlescape.hh"
 
+#include <deque>
+#include <exception>
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -42,8 +45,10 @@
 #include <QtCore5Compat>
 #endif
 #include <QSemaphore>
+#include <QThread>
 #include <QThreadPool>
 #include <QAtomicInt>
+#include <QWaitCondition>
 
 #include "utils.hh"
 
@@ -89,7 +94,7 @@ DEF_EX_STR( exDictzipError, "DICTZIP error", Dictionary::Ex )
 enum
 {
   Signature = 0x46584458, // XDXF on little-endian, FXDX on big-endian
-  CurrentFormatVersion = 6 + BtreeIndexing::FormatVersion + Folding::Version
+  CurrentFormatVersion = 6 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion + Folding::Version
 };
 
 enum ArticleFormat
@@ -151,7 +156,6 @@ class XdxfDictionary: public BtreeIndexing::BtreeDictionary
   sptr< ChunkedStorage::Reader > chunks;
   QMutex dzMutex;
   dictData * dz;
-  QMutex resourceZipMutex;
   IndexedZip resourceZip;
   map< string, string > abrv;
 
@@ -660,6 +664,17 @@ class GzippedFile: public QIODevice
 {
   gzFile gz;
 
+  /// The file is read in blocks of this size, even though readData() hands
+  /// out single characters
+  enum { BufferSize = 65536 };
+
+  vector< char > buffer;
+  size_t bufferPos, bufferEnd;
+  bool readError;
+
+  /// Returns the next byte of the file, or -1 at the end or on error
+  int nextByte();
+
 public:
 
   GzippedFile( char const * fileName ) ;
@@ -678,11 +693,11 @@ protected:
   { return false; } // Which is a lie, but else pos() won't work
 
   bool waitForReadyRead ( int ) override
-  { return !gzeof( gz ); }
+  { return !atEnd(); }
 
   qint64 bytesAvailable() const override
   {
-     return ( gzeof( gz ) ? 0 : 1 ) + QIODevice::bytesAvailable();
+     return ( atEnd() ? 0 : 1 ) + QIODevice::bytesAvailable();
   }
 
   qint64 readData( char * data, qint64 maxSize ) override;
@@ -693,7 +708,11 @@ protected:
   { return -1; }
 };
 
-GzippedFile::GzippedFile( char const * fileName ) 
+GzippedFile::GzippedFile( char const * fileName ):
+  buffer( BufferSize ),
+  bufferPos( 0 ),
+  bufferEnd( 0 ),
+  readError( false )
 {
   gz = gd_gzopen( fileName );
   if ( !gz )
@@ -712,7 +731,26 @@ GzippedFile::~GzippedFile()
 
 bool GzippedFile::atEnd() const
 {
-  return gzeof( gz );
+  return bufferPos == bufferEnd && gzeof( gz );
+}
+
+int GzippedFile::nextByte()
+{
+  if ( bufferPos == bufferEnd )
+  {
+    int n = gzread( gz, buffer.data(), buffer.size() );
+
+    if ( n <= 0 )
+    {
+      readError = n < 0;
+      return -1;
+    }
+
+    bufferPos = 0;
+    bufferEnd = n;
+  }
+
+  return (unsigned char) buffer[ bufferPos++ ];
 }
 
 /*
@@ -724,33 +762,39 @@ size_t GzippedFile::gzTell()
 
 qint64 GzippedFile::readData( char * data, qint64 maxSize )
 {
-  if ( maxSize > 1 )
-    maxSize = 1;
+  // Only one character is returned at a time, so that pos() points right
+  // past the last character parsed. The articles' offsets are taken from it.
+
+  if ( maxSize < 1 )
+    return 0;
+
+  int c = nextByte();
 
-  // The returning value translates directly to QIODevice semantics
-  int n = gzread( gz, data, maxSize );
+  if ( c < 0 )
+    return readError ? -1 : 0;
+
+  *data = c;
+
+  qint64 n = 1;
 
   // With QT 5.x QXmlStreamReader ask one byte instead of one UTF-8 char.
   // We read and return all bytes for char.
 
-  if( n == 1 )
+  char ch = *data;
+  int addBytes = 0;
+  if( ch & 0x80 )
   {
-    char ch = *data;
-    int addBytes = 0;
-    if( ch & 0x80 )
-    {
-      if( ( ch & 0xF8 ) == 0xF0 )
-        addBytes = 3;
-      else if( ( ch & 0xF0 ) == 0xE0 )
-        addBytes = 2;
-      else if( ( ch & 0xE0 ) == 0xC0 )
-        addBytes = 1;
-    }
-
-    if( addBytes )
-      n += gzread( gz, data + 1, addBytes );
+    if( ( ch & 0xF8 ) == 0xF0 )
+      addBytes = 3;
+    else if( ( ch & 0xF0 ) == 0xE0 )
+      addBytes = 2;
+    else if( ( ch & 0xE0 ) == 0xC0 )
+      addBytes = 1;
   }
 
+  for( ; addBytes > 0 && ( c = nextByte() ) >= 0; --addBytes )
+    data[ n++ ] = c;
+
   return n;
 }
 
@@ -834,6 +878,129 @@ void addAllKeyTags( QXmlStreamReader & stream, list< QString > & words )
   }
 }
 
+/// Runs the jobs posted to it on a separate thread, one after another in the
+/// order they were posted. This lets the parser go on extracting articles
+/// while the extracted ones get stored and their headwords folded.
+class IndexingPipeline
+{
+  enum { MaxQueuedJobs = 256 };
+
+  QMutex mutex;
+  QWaitCondition jobsChanged;
+  std::deque< std::function< void() > > jobs;
+  bool finishing = false;
+  std::exception_ptr error;
+  QFuture< void > f;
+
+  void run();
+
+public:
+
+  IndexingPipeline()
+  {
+    f = QtConcurrent::run( [ this ]() {
+      this->run();
+    } );
+  }
+
+  /// Drops the jobs not run yet, and waits for the one running, if any. So
+  /// everything the jobs refer to must outlive the pipeline.
+  ~IndexingPipeline();
+
+  /// Throws if the calling thread, which is the one posting the jobs, was
+  /// asked to stop. The jobs run on another thread, so the indexed words
+  /// can't tell it by themselves.
+  void checkInterruption();
+
+  /// Queues the job, waiting while too many jobs are queued already
+  void post( std::function< void() > job );
+
+  /// Waits for all the jobs to finish. Rethrows the exception thrown by a
+  /// job, if any; the jobs after it are not run.
+  void finish();
+};
+
+IndexingPipeline::~IndexingPipeline()
+{
+  {
+    QMutexLocker _( &mutex );
+    jobs.clear();
+    finishing = true;
+    jobsChanged.wakeAll();
+  }
+
+  f.waitForFinished();
+}
+
+void IndexingPipeline::checkInterruption()
+{
+  // Unwinding destroys the pipeline, dropping the jobs left
+  if ( QThread::currentThread()->isInterruptionRequested() )
+    throw BtreeIndexing::exIndexingInterrupted();
+}
+
+void IndexingPipeline::post( std::function< void() > job )
+{
+  QMutexLocker _( &mutex );
+
+  while ( jobs.size() >= MaxQueuedJobs )
+    jobsChanged.wait( &mutex );
+
+  jobs.push_back( std::move( job ) );
+  jobsChanged.wakeAll();
+}
+
+void IndexingPipeline::finish()
+{
+  {
+    QMutexLocker _( &mutex );
+    finishing = true;
+    jobsChanged.wakeAll();
+  }
+
+  f.waitForFinished();
+
+  if ( error )
+    std::rethrow_exception( error );
+}
+
+void IndexingPipeline::run()
+{
+  QMutexLocker _( &mutex );
+
+  for ( ;; )
+  {
+    if ( jobs.empty() )
+    {
+      if ( finishing )
+        return;
+
+      jobsChanged.wait( &mutex );
+      continue;
+    }
+
+    std::function< void() > job = std::move( jobs.front() );
+    jobs.pop_front();
+    jobsChanged.wakeAll();
+
+    if ( error )
+      continue; // Skip the rest after a failure
+
+    _.unlock();
+
+    try
+    {
+      job();
+    }
+    catch( ... )
+    {
+      error = std::current_exception();
+    }
+
+    _.relock();
+  }
+}
+
 void checkArticlePosition( GzippedFile & gzFile,
                            uint32_t *pOffset,
                            uint32_t *pSize )
@@ -855,6 +1022,7 @@ void checkArticlePosition( GzippedFile & gzFile,
 
 void indexArticle( GzippedFile & gzFile,
                    QXmlStreamReader & stream,
+                   IndexingPipeline & pipeline,
                    IndexedWords & indexedWords,
                    ChunkedStorage::Writer & chunks,
                    unsigned & articleCount,
@@ -896,33 +1064,34 @@ void indexArticle( GzippedFile & gzFile,
       }
       else
       {
-        // Add an entry
-
-        uint32_t offset = chunks.startNewBlock();
+        // Add an entry. That is done by the pipeline, while the parsing
+        // goes on.
 
         uint32_t offs = articleOffset;
         uint32_t size = gzFile.pos() - 1 - articleOffset;
 
-        checkArticlePosition( gzFile, &offs, &size );
+        pipeline.post( [ &, offs, size, format, words ]() mutable {
+          uint32_t offset = chunks.startNewBlock();
 
-        unsigned char f = format;
-        chunks.addToBlock( &f, 1 );
-        chunks.addToBlock( &offs, sizeof( offs ) );
-        chunks.addToBlock( &size, sizeof( size ) );
+          checkArticlePosition( gzFile, &offs, &size );
 
-        // Add also first header - it's needed for full-text search
-        chunks.addToBlock( words.begin()->toUtf8().data(), words.begin()->toUtf8().length() + 1 );
+          unsigned char f = format;
+          chunks.addToBlock( &f, 1 );
+          chunks.addToBlock( &offs, sizeof( offs ) );
+          chunks.addToBlock( &size, sizeof( size ) );
 
-//        GD_DPRINTF( "%x: %s\n", articleOffset, words.begin()->toUtf8().data() );
+          // Add also first header - it's needed for full-text search
+          chunks.addToBlock( words.begin()->toUtf8().data(), words.begin()->toUtf8().length() + 1 );
 
-        // Add words to index
+          // Add words to index
 
-        for ( const auto & word : words )
-          indexedWords.addWord( gd::toWString( word ), offset );
+          for ( const auto & word : words )
+            indexedWords.addWord( gd::toWString( word ), offset );
 
-        ++articleCount;
+          ++articleCount;
 
-        wordCount += words.size();
+          wordCount += words.size();
+        } );
       }
 
       return;
@@ -1098,13 +1267,16 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         // Building the index
 
         gdDebug( "Xdxf: Building the index for dictionary: %s\n", fileName.c_str() );
 
         //initializing.indexingDictionary( nameFromFileName( dictFiles[ 0 ] ) );
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
 
         IdxHeader idxHeader;
         map< string, string > abrv;
@@ -1129,6 +1301,13 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
         ChunkedStorage::Writer chunks( idx );
 
+        unsigned articleCount = 0, wordCount = 0;
+
+        // Everything written to the chunks and the indexed words goes
+        // through the pipeline, so the writes stay in the parsing order.
+        // What the jobs write to is declared above, so it outlives them.
+        IndexingPipeline pipeline;
+
         // Wait for the first element, which must be xdxf
 
         bool hadXdxf = false;
@@ -1161,8 +1340,6 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
               idxHeader.articleFormat = isLogical ? Logical : Visual;
 
-              unsigned articleCount = 0, wordCount = 0;
-
               while( !stream.atEnd() )
               {
                 stream.readNext();
@@ -1182,13 +1359,13 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
                       initializing.indexingDictionary( dictionaryName.toUtf8().data() );
 
-                      idxHeader.nameAddress = chunks.startNewBlock();
-
-                      QByteArray n = dictionaryName.toUtf8();
+                      pipeline.post( [ &, n = dictionaryName.toUtf8() ]() {
+                        idxHeader.nameAddress = chunks.startNewBlock();
 
-                      idxHeader.nameSize = n.size();
+                        idxHeader.nameSize = n.size();
 
-                      chunks.addToBlock( n.data(), n.size() );
+                        chunks.addToBlock( n.data(), n.size() );
+                      } );
                     }
                     else
                     {
@@ -1211,13 +1388,14 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
                     if ( dictionaryDescription.isEmpty() )
                     {
                       dictionaryDescription = desc;
-                      idxHeader.descriptionAddress = chunks.startNewBlock();
 
-                      QByteArray n = dictionaryDescription.toUtf8();
+                      pipeline.post( [ &, n = dictionaryDescription.toUtf8() ]() {
+                        idxHeader.descriptionAddress = chunks.startNewBlock();
 
-                      idxHeader.descriptionSize = n.size();
+                        idxHeader.descriptionSize = n.size();
 
-                      chunks.addToBlock( n.data(), n.size() );
+                        chunks.addToBlock( n.data(), n.size() );
+                      } );
                     }
                     else
                     {
@@ -1316,12 +1494,18 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
                   else
                   if ( stream.name() == u"ar" )
                   {
-                    indexArticle( gzFile, stream, indexedWords, chunks,
+                    pipeline.checkInterruption();
+
+                    indexArticle( gzFile, stream, pipeline, indexedWords, chunks,
                                   articleCount, wordCount, isLogical ? Logical : Visual );
                   }
                 }
               }
 
+              // Wait for the articles to be stored
+
+              pipeline.finish();
+
               // Write abbreviations if presented
 
               if( !abrv.empty() )
@@ -1399,6 +1583,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
               idx.rewind();
 
               idx.write( &idxHeader, sizeof( idxHeader ) );
+              idx.commit();
+              Dictionary::indexBuilt( dictFiles, indexFile );
 
               hadXdxf = true;
             }
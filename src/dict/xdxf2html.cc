@@ -60,6 +60,36 @@ string convertToRoman( int input, int lower_case )
     return romanvalue;
 }
 
+/// Collects all the elements under the given node, grouped by their tag
+/// names, each group in document order
+static void collectElements( QDomNode const & root, QHash< QString, QVector< QDomElement > > & elements )
+{
+  QDomNode node = root.firstChild();
+
+  while( !node.isNull() )
+  {
+    if( node.isElement() )
+    {
+      QDomElement el = node.toElement();
+      elements[ el.tagName() ].append( el );
+    }
+
+    if( node.hasChildNodes() )
+    {
+      node = node.firstChild();
+      continue;
+    }
+
+    while( node != root && node.nextSibling().isNull() )
+      node = node.parentNode();
+
+    if( node == root )
+      break;
+
+    node = node.nextSibling();
+  }
+}
+
 QDomElement fakeElement( QDomDocument & dom )
 {
   // Create element which will be removed after
@@ -134,12 +164,17 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     return in;
   }
 
-  QDomNodeList nodes = dd.elementsByTagName( "ex" ); // Example
+  // Collect the elements in a single walk over the tree. Querying the
+  // document for each tag would walk it again and again, since the node
+  // lists are live and get re-evaluated after every change.
+  QHash< QString, QVector< QDomElement > > elements;
+  collectElements( dd, elements );
+
+  QVector< QDomElement > nodes = elements.value( "ex" ); // Example
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
     QString author, source;
-    QDomElement el = nodes.at( 0 ).toElement();
 
     author = el.attribute( "author", QString() );
     source = el.attribute( "source", QString() );
@@ -189,12 +224,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
       el.setAttribute( "class", "xdxf_ex_old" );
   }
   
-  nodes = dd.elementsByTagName( "mrkd" ); // marked out words in translations/examples of usage
+  nodes = elements.value( "mrkd" ); // marked out words in translations/examples of usage
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -202,15 +235,13 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     el.setAttribute( "class", "xdxf_ex_markd" );
   }
 
-  nodes = dd.elementsByTagName( "k" ); // Key
+  nodes = elements.value( "k" ); // Key
 
   if( headword )
     headword->clear();
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -246,7 +277,7 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
   // processing of nested <def>s
   if( isLogicalFormat ) // in articles with visual format <def> tags do not effect the formatting.
   {
-    nodes = dd.elementsByTagName( "def" );
+    nodes = elements.value( "def" );
     
     // this is a logical type of XDXF, so we need to render proper numbering
     // we will do it this way:
@@ -329,9 +360,8 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
       }
     }
     // we finally change all <def> tags into 'xdxf_def' <span>s
-    while( nodes.size() )
+    for( QDomElement el : nodes )
     {
-      QDomElement el = nodes.at( 0 ).toElement();
       el.setTagName( "span" );
       el.setAttribute( "class", "xdxf_def" );
       bool isLanguageRtl = dictPtr->isToLanguageRTL();
@@ -351,12 +381,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     }
   }
   
-  nodes = dd.elementsByTagName( "opt" ); // Optional headword part
+  nodes = elements.value( "opt" ); // Optional headword part
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -364,12 +392,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     el.setAttribute( "class", "xdxf_opt" );
   }
 
-  nodes = dd.elementsByTagName( "kref" ); // Reference to another word
+  nodes = elements.value( "kref" ); // Reference to another word
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -388,12 +414,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     }
   }
 
-  nodes = dd.elementsByTagName( "iref" ); // Reference to internet site
+  nodes = elements.value( "iref" ); // Reference to internet site
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -407,14 +431,12 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
 
   // Abbreviations
   if( revisionNumber < 29 )
-    nodes = dd.elementsByTagName( "abr" );
+    nodes = elements.value( "abr" );
   else
-    nodes = dd.elementsByTagName( "abbr" );
+    nodes = elements.value( "abbr" );
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -463,12 +485,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     }
   }
 
-  nodes = dd.elementsByTagName( "dtrn" ); // Direct translation
+  nodes = elements.value( "dtrn" ); // Direct translation
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -476,12 +496,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     el.setAttribute( "class", "xdxf_dtrn" );
   }
 
-  nodes = dd.elementsByTagName( "c" ); // Color
+  nodes = elements.value( "c" ); // Color
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -496,12 +514,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
       el.setAttribute( "style", "color:blue" );
   }
 
-  nodes = dd.elementsByTagName( "co" ); // Editorial comment
+  nodes = elements.value( "co" ); // Editorial comment
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -513,11 +529,9 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
   }
 
   /* grammar information */
-  nodes = dd.elementsByTagName( "gr" ); // proper grammar tag
-  while( nodes.size() )
+  nodes = elements.value( "gr" ); // proper grammar tag
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -527,11 +541,9 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     else
       el.setAttribute( "class", "xdxf_gr_old" );
   }
-  nodes = dd.elementsByTagName( "pos" ); // deprecated grammar tag
-  while( nodes.size() )
+  nodes = elements.value( "pos" ); // deprecated grammar tag
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -541,11 +553,9 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     else
       el.setAttribute( "class", "xdxf_gr_old" );
   }
-  nodes = dd.elementsByTagName( "tense" ); // deprecated grammar tag
-  while( nodes.size() )
+  nodes = elements.value( "tense" ); // deprecated grammar tag
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -557,12 +567,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
   }
   /* end of grammar generation */
   
-  nodes = dd.elementsByTagName( "tr" ); // Transcription
+  nodes = elements.value( "tr" ); // Transcription
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -577,7 +585,7 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
   // We modify the URL by using the dictionary ID as the hostname.
   // This is necessary to determine from which dictionary a requested
   // image originates.
-  nodes = dd.elementsByTagName( "img" );
+  nodes = elements.value( "img" );
 
   for( int i = 0; i < nodes.size(); i++ )
   {
@@ -602,12 +610,10 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
     }
   }
 
-  nodes = dd.elementsByTagName( "rref" ); // Resource reference
+  nodes = elements.value( "rref" ); // Resource reference
 
-  while( nodes.size() )
+  for( QDomElement el : nodes )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
     if( el.text().isEmpty() && el.childNodes().isEmpty() )
       el.appendChild( fakeElement( dd ) );
 
@@ -847,11 +847,12 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
     string indexFile = indicesDir + dictId;
 
-    initializing.indexingDictionary( df.getFilename() );
-
     try {
       //only check zim file.
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile ) ) {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         gdDebug( "Zim: Building the index for dictionary: %s\n", fileName.c_str() );
 
         unsigned articleCount = df.getArticleCount();
@@ -862,7 +863,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           initializing.indexingDictionary( firstName.mid( n + 1 ).toUtf8().constData() );
         }
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
         IdxHeader idxHeader;
         memset( &idxHeader, 0, sizeof( idxHeader ) );
         idxHeader.namePtr        = 0xFFFFFFFF;
@@ -933,6 +934,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.rewind();
 
         idx.write( &idxHeader, sizeof( idxHeader ) );
+        idx.commit();
+        Dictionary::indexBuilt( dictFiles, indexFile );
       }
 
       dictionaries.push_back( std::make_shared< ZimDictionary >( dictId, indexFile, dictFiles ) );
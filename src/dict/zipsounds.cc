@@ -43,7 +43,7 @@ DEF_EX( exInvalidData, "Invalid data encountered", Dictionary::Ex )
 enum
 {
   Signature = 0x5350495a, // ZIPS on little-endian, SPIZ on big-endian
-  CurrentFormatVersion = 6 + BtreeIndexing::FormatVersion
+  CurrentFormatVersion = 6 + BtreeIndexing::FormatVersion + ChunkedStorage::FormatVersion
 };
 
 struct IdxHeader
@@ -355,22 +355,27 @@ sptr< Dictionary::DataRequest > ZipSoundsDictionary::getResource( string const &
   // Find sound
 
   uint32_t dataOffset = 0;
-  for( int x = chain.size() - 1; x >= 0 ; x-- )
   {
-    vector< char > chunk;
-    char * nameBlock = chunks->getBlock( chain[ x ].articleOffset, chunk );
+    // Only the lookup in the chunks needs the lock, the zip is read lock-free
+    QMutexLocker _( &idxMutex );
 
-    uint16_t sz;
-    memcpy( &sz, nameBlock, sizeof( uint16_t ) );
-    nameBlock += sizeof( uint16_t );
+    for( int x = chain.size() - 1; x >= 0 ; x-- )
+    {
+      vector< char > chunk;
+      char * nameBlock = chunks->getBlock( chain[ x ].articleOffset, chunk );
 
-    string fileName( nameBlock, sz );
-    nameBlock += sz;
+      uint16_t sz;
+      memcpy( &sz, nameBlock, sizeof( uint16_t ) );
+      nameBlock += sizeof( uint16_t );
+
+      string fileName( nameBlock, sz );
+      nameBlock += sz;
 
-    memcpy( &dataOffset, nameBlock, sizeof( uint32_t ) );
+      memcpy( &dataOffset, nameBlock, sizeof( uint32_t ) );
 
-    if( name.compare( fileName ) == 0 )
-      break;
+      if( name.compare( fileName ) == 0 )
+        break;
+    }
   }
 
   sptr< Dictionary::DataRequestInstant > dr =
@@ -428,9 +433,12 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        if ( initializing.isIndexingDeferred( dictFiles ) )
+          continue; // It will be built in the background
+
         gdDebug( "Zips: Building the index for dictionary: %s\n", i->c_str() );
 
-        File::Class idx( indexFile, "wb" );
+        File::Replacement idx( indexFile );
         IdxHeader idxHeader;
 
         memset( &idxHeader, 0, sizeof( idxHeader ) );
@@ -441,7 +449,7 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         idx.write( idxHeader );
 
         IndexedWords names, zipFileNames;
-        ChunkedStorage::Writer chunks( idx );
+        ChunkedStorage::Writer chunks( idx, ChunkedStorage::SmallBlocksChunkSize );
         quint32 namesCount;
 
         IndexedZip zipFile;
@@ -492,6 +500,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           idx.rewind();
 
           idx.write( &idxHeader, sizeof( idxHeader ) );
+          idx.commit();
+          Dictionary::indexBuilt( dictFiles, indexFile );
         }
         else
         {
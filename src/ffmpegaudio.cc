@@ -15,6 +15,9 @@ extern "C" {
 
 #include <QString>
 #include <QDataStream>
+#include <QCryptographicHash>
+
+#include <memory>
 
 #include <vector>
 #if( QT_VERSION >= QT_VERSION_CHECK( 6, 2, 0 ) )
@@ -30,7 +33,10 @@ using std::vector;
 namespace Ffmpeg
 {
 
-QMutex DecoderThread::deviceMutex_;
+enum
+{
+  MaxCacheSize = 32 * 1024 * 1024 // Total size of the decoded clips kept in the cache
+};
 
 static inline QString avErrorString( int errnum )
 {
@@ -45,7 +51,8 @@ AudioService & AudioService::instance()
   return a;
 }
 
-AudioService::AudioService()
+AudioService::AudioService():
+  decoderThread( nullptr )
 {
 //  ao_initialize();
 }
@@ -58,15 +65,17 @@ AudioService::~AudioService()
 
 void AudioService::playMemory( const char * ptr, int size )
 {
-  emit cancelPlaying( false );
-  QByteArray audioData( ptr, size );
-  DecoderThread * thread = new DecoderThread( audioData, this );
+  if ( !decoderThread )
+  {
+    decoderThread = new DecoderThread( this );
+
+    connect( decoderThread, &DecoderThread::error, this, &AudioService::error );
+    connect( this, &AudioService::cancelPlaying, decoderThread, &DecoderThread::cancel, Qt::DirectConnection );
 
-  connect( thread, &DecoderThread::error, this, &AudioService::error );
-  connect( this, &AudioService::cancelPlaying, thread, &DecoderThread::cancel, Qt::DirectConnection );
-  connect( thread, &QThread::finished, thread, &QObject::deleteLater );
+    decoderThread->start();
+  }
 
-  thread->start();
+  decoderThread->play( QByteArray( ptr, size ) );
 }
 
 void AudioService::stop()
@@ -81,7 +90,6 @@ struct DecoderContext
     kBufferSize = 32768
   };
 
-  static QMutex deviceMutex_;
   QAtomicInt & isCancelled_;
   QByteArray audioData_;
   QDataStream audioDataStream_;
@@ -95,12 +103,15 @@ struct DecoderContext
   AVIOContext * avioContext_;
   AVStream * audioStream_;
 //  ao_device * aoDevice_;
-  AudioOutput * audioOutput;
+  AudioOutput & audioOutput;
+  bool outputFailed;
   bool avformatOpened_;
 
   SwrContext *swr_;
 
-  DecoderContext( QByteArray const & audioData, QAtomicInt & isCancelled );
+  QByteArray decodedSamples; // Everything played so far, for the cache
+
+  DecoderContext( QByteArray const & audioData, QAtomicInt & isCancelled, AudioOutput & output );
   ~DecoderContext();
 
   bool openCodec( QString & errorString );
@@ -112,7 +123,7 @@ struct DecoderContext
   void playFrame( AVFrame * frame );
 };
 
-DecoderContext::DecoderContext( QByteArray const & audioData, QAtomicInt & isCancelled ):
+DecoderContext::DecoderContext( QByteArray const & audioData, QAtomicInt & isCancelled, AudioOutput & output ):
   isCancelled_( isCancelled ),
   audioData_( audioData ),
   audioDataStream_( audioData_ ),
@@ -121,7 +132,8 @@ DecoderContext::DecoderContext( QByteArray const & audioData, QAtomicInt & isCan
   codecContext_( NULL ),
   avioContext_( NULL ),
   audioStream_( NULL ),
-  audioOutput( new AudioOutput ),
+  audioOutput( output ),
+  outputFailed( false ),
   avformatOpened_( false ),
   swr_( NULL )
 {
@@ -326,7 +338,7 @@ bool DecoderContext::openOutputDevice( QString & errorString )
   }
   #endif
 
-  audioOutput->setAudioFormat( 44100, codecContext_->channels );
+  audioOutput.setAudioFormat( 44100, codecContext_->channels );
   return true;
 }
 
@@ -418,53 +430,157 @@ void DecoderContext::playFrame( AVFrame * frame )
     return;
 
   vector<uint8_t> samples;
-  if ( normalizeAudio( frame, samples ) )
+  if ( normalizeAudio( frame, samples ) && !samples.empty() )
   {
-    audioOutput->play(&samples.front(), samples.size());
+    // Each frame is played as soon as it's decoded
+    if ( !audioOutput.play( &samples.front(), samples.size() ) )
+      outputFailed = true;
+
+    decodedSamples.append( reinterpret_cast< char const * >( &samples.front() ), samples.size() );
   }
 }
 
-DecoderThread::DecoderThread( QByteArray const & audioData, QObject * parent ) :
+DecoderThread::DecoderThread( QObject * parent ) :
   QThread( parent ),
+  hasPending_( false ),
+  clearOutput_( false ),
+  quit_( false ),
   isCancelled_( 0 ),
-  audioData_( audioData )
+  cacheSize_( 0 )
 {
 }
 
 DecoderThread::~DecoderThread()
 {
+  cancel( true );
+}
+
+void DecoderThread::play( QByteArray const & audioData )
+{
+  QMutexLocker _( &mutex_ );
+
+  pendingAudioData_ = audioData;
+  hasPending_ = true;
+  clearOutput_ = true;
   isCancelled_.ref();
+
+  wakeUp_.wakeOne();
 }
 
 void DecoderThread::run()
 {
-  QString errorString;
-  DecoderContext d( audioData_, isCancelled_ );
+  // The output is reused for all the clips, unless it fails
+  std::unique_ptr< AudioOutput > output;
 
-  if ( !d.openCodec( errorString ) )
+  for ( ; ; )
   {
-    emit error( errorString );
-    return;
+    QByteArray audioData;
+
+    {
+      QMutexLocker _( &mutex_ );
+
+      while ( !quit_ && !hasPending_ && !clearOutput_ )
+        wakeUp_.wait( &mutex_ );
+
+      if ( quit_ )
+        break;
+
+      if ( clearOutput_ )
+      {
+        // Whatever is still queued belongs to a clip which was stopped
+        if ( output )
+          output->clear();
+        clearOutput_ = false;
+      }
+
+      if ( !hasPending_ )
+        continue;
+
+      audioData.swap( pendingAudioData_ );
+      hasPending_ = false;
+      isCancelled_.storeRelease( 0 );
+    }
+
+    if ( !output )
+      output.reset( new AudioOutput );
+
+    QByteArray key = QCryptographicHash::hash( audioData, QCryptographicHash::Sha1 );
+
+    if ( CachedClip const * clip = findInCache( key ) )
+    {
+      output->setAudioFormat( 44100, clip->channels );
+      if ( !output->play( reinterpret_cast< uint8_t const * >( clip->samples.constData() ), clip->samples.size() ) )
+        output.reset();
+      continue;
+    }
+
+    QString errorString;
+    DecoderContext d( audioData, isCancelled_, *output );
+
+    if ( !d.openCodec( errorString ) )
+    {
+      emit error( errorString );
+      continue;
+    }
+
+    if ( !d.openOutputDevice( errorString ) )
+      emit error( errorString );
+    else if ( !d.play( errorString ) )
+      emit error( errorString );
+    else if ( !Utils::AtomicInt::loadAcquire( isCancelled_ ) )
+      addToCache( key, d.codecContext_->channels, d.decodedSamples );
+
+    d.closeOutputDevice();
+
+    if ( d.outputFailed )
+      output.reset();
   }
+}
 
-  while ( !deviceMutex_.tryLock( 100 ) )
+DecoderThread::CachedClip const * DecoderThread::findInCache( QByteArray const & key )
+{
+  for ( auto i = cache_.begin(); i != cache_.end(); ++i )
   {
-    if ( Utils::AtomicInt::loadAcquire( isCancelled_ ) )
-      return;
+    if ( i->key == key )
+    {
+      cache_.splice( cache_.begin(), cache_, i );
+      return &cache_.front();
+    }
   }
 
-  if ( !d.openOutputDevice( errorString ) )
-    emit error( errorString );
-  else if ( !d.play( errorString ) )
-    emit error( errorString );
+  return nullptr;
+}
+
+void DecoderThread::addToCache( QByteArray const & key, int channels, QByteArray const & samples )
+{
+  if ( samples.isEmpty() || samples.size() > MaxCacheSize / 4 )
+    return; // Long recordings would just push everything else out
 
-  d.closeOutputDevice();
-  deviceMutex_.unlock();
+  cache_.push_front( CachedClip{ key, channels, samples } );
+  cacheSize_ += samples.size();
+
+  while ( cacheSize_ > MaxCacheSize )
+  {
+    cacheSize_ -= cache_.back().samples.size();
+    cache_.pop_back();
+  }
 }
 
 void DecoderThread::cancel( bool waitUntilFinished )
 {
-  isCancelled_.ref();
+  {
+    QMutexLocker _( &mutex_ );
+
+    pendingAudioData_.clear();
+    hasPending_ = false;
+    clearOutput_ = true;
+    if ( waitUntilFinished )
+      quit_ = true;
+    isCancelled_.ref();
+
+    wakeUp_.wakeOne();
+  }
+
   if ( waitUntilFinished )
     this->wait();
 }
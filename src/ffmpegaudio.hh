@@ -8,10 +8,14 @@
 #include <QAtomicInt>
 #include <QByteArray>
 #include <QThread>
+#include <QWaitCondition>
+#include <list>
 
 namespace Ffmpeg
 {
 
+class DecoderThread;
+
 class AudioService : public QObject
 {
   Q_OBJECT
@@ -28,26 +32,55 @@ signals:
 private:
   AudioService();
   ~AudioService();
+
+  DecoderThread * decoderThread;
 };
 
+/// Decodes and plays the clips one after another. The thread and its audio
+/// output live as long as the service, and the decoded clips are kept in a
+/// small cache, so playing the same clip again doesn't need decoding.
 class DecoderThread: public QThread
 {
   Q_OBJECT
 
-  static QMutex deviceMutex_;
-  QAtomicInt isCancelled_;
-  QByteArray audioData_;
+  QMutex mutex_;
+  QWaitCondition wakeUp_;
+  QByteArray pendingAudioData_; // The next clip to play
+  bool hasPending_;
+  bool clearOutput_; // The samples queued to the output are to be dropped
+  bool quit_;
+  QAtomicInt isCancelled_; // Cancels the clip being played
+
+  /// Decoded clips, most recently used first. Only used by the thread itself.
+  struct CachedClip
+  {
+    QByteArray key; // Hash of the encoded data
+    int channels;
+    QByteArray samples; // 16-bit, 44100 Hz
+  };
+
+  std::list< CachedClip > cache_;
+  qint64 cacheSize_;
 
 public:
-  DecoderThread( QByteArray const & audioData, QObject * parent );
+  DecoderThread( QObject * parent );
   virtual ~DecoderThread();
 
+  /// Stops the clip being played, if any, and plays the given one.
+  void play( QByteArray const & audioData );
+
 public slots:
-  void run();
   void cancel( bool waitUntilFinished );
 
+protected:
+  void run() override;
+
 signals:
   void error( QString const & message );
+
+private:
+  CachedClip const * findInCache( QByteArray const & key );
+  void addToCache( QByteArray const & key, int channels, QByteArray const & samples );
 };
 
 }
@@ -1,8 +1,24 @@
 #include "headwordsmodel.hh"
-#include "wstring_qt.hh"
+#include "gddebug.hh"
+
+#include <QTimer>
+
+namespace {
+/// Number of headwords a single fetchMore() tries to add
+int const PageSize = 1000;
+/// Number of headwords a single filtered fetchMore() may scan, matching or not
+int const ScanLimit = 50000;
+} // namespace
 
 HeadwordListModel::HeadwordListModel( QObject * parent ) :
-  QAbstractListModel( parent ), filtering( false ), totalSize(0), index( 0 ),ptr( nullptr )
+  QAbstractListModel( parent ),
+  filtering( false ),
+  scanned( 0 ),
+  fetchScheduled( false ),
+  totalSize( 0 ),
+  _dict( nullptr ),
+  position( 0 ),
+  finish( false )
 {
 }
 
@@ -18,102 +34,37 @@ int HeadwordListModel::totalCount() const
 
 bool HeadwordListModel::isFinish() const
 {
-  return words.size() >= totalSize;
-}
-
-// export headword
-QString HeadwordListModel::getRow( int row )
-{
-  if( fileSortedList.empty() )
-  {
-    fileSortedList << words;
-    fileSortedList.sort();
-  }
-  return fileSortedList.at( row );
+  return finish;
 }
 
 void HeadwordListModel::setFilter( QRegularExpression reg )
 {
-  if( reg.pattern().isEmpty() )
-  {
-    filtering = false;
-    return;
-  }
-  filtering = true;
-  filterWords.clear();
-  auto sr = _dict->prefixMatch( gd::removeTrailingZero( reg.pattern() ), 500 );
-  connect( sr.get(), &Dictionary::Request::finished, this, &HeadwordListModel::requestFinished, Qt::QueuedConnection );
-  queuedRequests.push_back( sr );
-}
+  filtering = reg.isValid() && !reg.pattern().isEmpty();
+  filter    = filtering ? reg : QRegularExpression();
 
-void HeadwordListModel::appendWord( const QString & word )
-{
-  hashedWords.insert( word );
-  words.append( word );
+  restart();
 }
 
-void HeadwordListModel::addMatches( QStringList matches)
+void HeadwordListModel::setStartPrefix( QString const & prefix )
 {
-  QStringList filtered;
-  for ( auto const & w : matches ) {
-    if ( !containWord( w ) ) {
-      filtered << w;
-    }
-  }
-
-  if ( filtered.isEmpty() )
-    return;
+  startPrefix = prefix;
 
-  beginInsertRows( QModelIndex(), words.size(), words.size() + filtered.count() - 1 );
-  for ( const auto & word : filtered ) {
-    appendWord( word );
-  }
-  endInsertRows();
+  restart();
 }
 
-void HeadwordListModel::requestFinished()
+void HeadwordListModel::restart()
 {
-  // See how many new requests have finished, and if we have any new results
-  for( auto i = queuedRequests.begin();
-       i != queuedRequests.end(); )
-  {
-    if( ( *i )->isFinished() )
-    {
-      if( !( *i )->getErrorString().isEmpty() )
-      {
-        qDebug() << "error:" << ( *i )->getErrorString();
-      }
+  beginResetModel();
 
-      if( ( *i )->matchesCount() )
-      {
-        auto allmatches = ( *i )->getAllMatches();
-        for( auto & match : allmatches )
-          filterWords.append( QString::fromStdU32String( match.word ) );
-      }
-      queuedRequests.erase( i++ );
-    }
-    else
-      ++i;
-  }
+  words.clear();
+  position = 0;
+  finish   = false;
+  scanned  = 0;
 
-  if( queuedRequests.empty() )
-  {
-    QStringList filtered;
-    for( auto & w : filterWords )
-    {
-      if( !containWord( w ) )
-      {
-        filtered << w;
-      }
-    }
-    if( filtered.isEmpty() )
-      return;
+  endResetModel();
 
-    beginInsertRows( QModelIndex(), words.size(), words.size() + filtered.count() - 1 );
-    for( const auto & word : filtered )
-      appendWord( word );
-    endInsertRows();
-  }
+  // Make sure the first page is there even if the view doesn't ask for it
+  fetchMore( QModelIndex() );
 }
 
 int HeadwordListModel::wordCount() const
@@ -121,12 +72,17 @@ int HeadwordListModel::wordCount() const
   return words.size();
 }
 
+int HeadwordListModel::scannedCount() const
+{
+  return scanned;
+}
+
 QVariant HeadwordListModel::data( const QModelIndex & index, int role ) const
 {
   if( !index.isValid() )
     return {};
 
-  if( index.row() >= totalSize || index.row() < 0 || index.row() >= words.size() )
+  if( index.row() < 0 || index.row() >= words.size() )
     return {};
 
   if( role == Qt::DisplayRole )
@@ -138,65 +94,77 @@ QVariant HeadwordListModel::data( const QModelIndex & index, int role ) const
 
 bool HeadwordListModel::canFetchMore( const QModelIndex & parent ) const
 {
-  if( parent.isValid() || filtering )
+  if( parent.isValid() || !_dict )
     return false;
-  return ( words.size() < totalSize );
+  return !finish;
 }
 
 void HeadwordListModel::fetchMore( const QModelIndex & parent )
 {
-  if( parent.isValid() || filtering )
+  if( parent.isValid() || !_dict || finish )
     return;
 
-  QSet< QString > headword;
   QMutexLocker _( &lock );
 
-  _dict->findHeadWordsWithLenth( index, &headword, 1000 );
-  if( headword.isEmpty() )
-  {
-    return;
-  }
+  QStringList page;
+  QStringList matched;
+  int const scanStart = scanned;
 
-  QSet< QString > filtered;
-  for( const auto & word : qAsConst( headword ) )
+  // Don't hang the ui scanning the whole index when the filter rejects most
+  while( !finish && matched.size() < PageSize && scanned - scanStart < ScanLimit )
   {
-    if( !containWord( word ) )
-      filtered.insert( word );
+    page.clear();
+
+    try
+    {
+      // The position is only zero before the first page
+      if( position == 0 && !startPrefix.isEmpty() )
+        finish = !_dict->findHeadWordsFrom( startPrefix, position, page );
+      else
+        finish = !_dict->findHeadWordsWithLenth( position, page, PageSize );
+    }
+    catch( std::exception & e )
+    {
+      gdWarning( "Headwords retrieving failed for \"%s\", reason: %s\n", _dict->getName().c_str(), e.what() );
+      finish = true;
+    }
+
+    scanned += page.size();
+
+    if( filtering )
+    {
+      for( const auto & word : qAsConst( page ) )
+      {
+        if( filter.match( word ).hasMatch() )
+          matched.append( word );
+      }
+    }
+    else
+      matched += page;
   }
 
-  beginInsertRows( QModelIndex(), words.size(), words.size() + filtered.count() - 1 );
-  for( const auto & word : filtered )
+  if( !matched.isEmpty() )
   {
-    appendWord( word );
+    beginInsertRows( QModelIndex(), words.size(), words.size() + matched.size() - 1 );
+    words += matched;
+    endInsertRows();
   }
-  endInsertRows();
 
   emit numberPopulated( words.size() );
-}
-
-int HeadwordListModel::getCurrentIndex() const
-{
-  return index;
-}
-
-bool HeadwordListModel::containWord( const QString & word )
-{
-  return hashedWords.contains( word );
-}
-
-QSet< QString > HeadwordListModel::getRemainRows( int & nodeIndex )
-{
-  QSet< QString > headword;
-  QMutexLocker _( &lock );
-  _dict->findHeadWordsWithLenth( nodeIndex, &headword, 10000 );
 
-  QSet< QString > filtered;
-  for( const auto & word : headword )
+  if( finish )
+    emit finished( words.size() );
+  else
+  if( matched.isEmpty() && !fetchScheduled )
   {
-    if( !containWord( word ) )
-      filtered.insert( word );
+    // No rows were added, so the view won't ask for more. Go on scanning
+    // from the event loop, letting the ui breathe in between.
+    fetchScheduled = true;
+    QTimer::singleShot( 0, this, [ this ]() {
+      fetchScheduled = false;
+      fetchMore( QModelIndex() );
+    } );
   }
-  return filtered;
 }
 
 void HeadwordListModel::setDict( Dictionary::Class * dict )
@@ -4,8 +4,13 @@
 #include "dict/dictionary.hh"
 
 #include <QAbstractListModel>
+#include <QRegularExpression>
 #include <QStringList>
 
+/// A model which pages the headwords in directly from the dictionary's
+/// index as the view scrolls, so the whole list is never loaded at once.
+/// When a filter is set, it is applied to each fetched page only. The list
+/// may start at some prefix rather than at the first headword.
 class HeadwordListModel : public QAbstractListModel
 {
   Q_OBJECT
@@ -16,39 +21,40 @@ public:
   int rowCount( const QModelIndex & parent = QModelIndex() ) const override;
   int totalCount() const;
   int wordCount() const;
+  /// Number of headwords read from the index so far, matching or not
+  int scannedCount() const;
   bool isFinish() const;
   QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const override;
-  QString getRow( int row );
   void setFilter( QRegularExpression );
-  void appendWord( const QString & word );
-  void addMatches( QStringList matches );
-  int getCurrentIndex() const;
-  bool containWord( const QString & word );
-  QSet< QString > getRemainRows( int & nodeIndex );
+  /// Restarts the list at the headwords beginning with the given prefix.
+  /// An empty one restarts it at the first headword.
+  void setStartPrefix( QString const & );
+
 signals:
   void numberPopulated( int number );
   void finished( int number );
 
 public slots:
   void setDict( Dictionary::Class * dict );
-  void requestFinished();
 
 protected:
   bool canFetchMore( const QModelIndex & parent ) const override;
   void fetchMore( const QModelIndex & parent ) override;
 
 private:
+  void restart();
+
   QStringList words;
-  QSet< QString > hashedWords;
-  QStringList filterWords;
+  QRegularExpression filter;
   bool filtering;
-  QStringList fileSortedList;
+  QString startPrefix;
+  int scanned;
+  bool fetchScheduled;
   long totalSize;
   Dictionary::Class * _dict;
-  int index;
-  char * ptr;
+  uint32_t position;
+  bool finish;
   QMutex lock;
-  std::list< sptr< Dictionary::WordSearchRequest > > queuedRequests;
 };
 
 #endif // HEADWORDSMODEL_H
@@ -54,14 +54,13 @@ bool IndexedZip::loadFile( uint32_t offset, vector< char > & data )
   if ( !zipIsOpen )
     return false;
 
-  // Now seek into the zip file and read its header
-
-  if ( !zip.seek( offset ) )
-    return false;
+  // Read the header at the offset. Only positional reads are used here,
+  // so several files may be loaded at once without any locking.
 
   ZipFile::LocalFileHeader header;
+  quint64 dataOffset;
 
-  if ( !ZipFile::readLocalHeader( zip, header ) )
+  if ( !ZipFile::readLocalHeaderAt( zip, offset, header, dataOffset ) )
   {
     GD_DPRINTF( "Failed to load header" );
     return false;
@@ -74,16 +73,25 @@ bool IndexedZip::loadFile( uint32_t offset, vector< char > & data )
     case ZipFile::Uncompressed:
       GD_DPRINTF( "Uncompressed" );
       data.resize( header.uncompressedSize );
-      return (size_t) zip.read( &data.front(), data.size() ) == data.size();
+      return (size_t) zip.readAt( dataOffset, data.data(), data.size() ) == data.size();
 
     case ZipFile::Deflated:
     {
-      // Now do the deflation
+      // Now do the deflation. Inflate straight from the mapping when the
+      // data lies within one volume, or from a copy otherwise.
 
-      QByteArray compressedData = zip.read( header.compressedSize );
+      QByteArray compressedData;
+      char const * compressed = zip.mappedData( dataOffset, header.compressedSize );
 
-      if ( compressedData.size() != (int)header.compressedSize )
-        return false;
+      if ( !compressed )
+      {
+        compressedData = zip.readAt( dataOffset, header.compressedSize );
+
+        if ( compressedData.size() != (int)header.compressedSize )
+          return false;
+
+        compressed = compressedData.constData();
+      }
 
       data.resize( header.uncompressedSize );
 
@@ -91,8 +99,8 @@ bool IndexedZip::loadFile( uint32_t offset, vector< char > & data )
 
       memset( &stream, 0, sizeof( stream ) );
 
-      stream.next_in = ( Bytef * ) compressedData.data();
-      stream.avail_in = compressedData.size();
+      stream.next_in = ( Bytef * ) compressed;
+      stream.avail_in = header.compressedSize;
       stream.next_out = ( Bytef * ) &data.front();
       stream.avail_out = data.size();
 
@@ -35,7 +35,8 @@ public:
   bool hasFile( gd::wstring const & name );
 
   /// Attempts loading the given file into the given vector. Returns true on
-  /// success, false otherwise.
+  /// success, false otherwise. Reading the zip file itself needs no locking,
+  /// so several files may be loaded concurrently.
   bool loadFile( gd::wstring const & name, std::vector< char > & );
   bool loadFile( uint32_t offset, std::vector< char > & );
 
@@ -12,20 +12,43 @@ void ResourceSchemeHandler::requestStarted(QWebEngineUrlRequestJob *requestJob)
     request.setUrl(url);
     request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
     QNetworkReply *reply = this->mManager.getArticleReply( request);
-    connect(reply, &QNetworkReply::finished, requestJob, [=]() {
-      if (reply->error() == QNetworkReply::ContentNotFoundError) {
-        requestJob->fail(QWebEngineUrlRequestJob::UrlNotFound);
+
+    // The type only depends on the resource name, so it is known before any data arrives.
+    QString contentType = reply->header( QNetworkRequest::ContentTypeHeader ).toString();
+    if ( contentType.isEmpty() )
+      contentType = db.mimeTypeForFile( url.path(), QMimeDatabase::MatchExtension ).name();
+
+    // Hand the reply over to the job as soon as the first bytes are available, so the
+    // page or media starts rendering while the rest is still being produced. Errors can
+    // only be reported while nothing has been sent yet.
+    auto replied = QSharedPointer< bool >::create( false );
+
+    auto startReply = [ = ]() {
+      if ( *replied )
         return;
-      }
-      if (reply->error() != QNetworkReply::NoError) {
-        qDebug() << "resource handler failed:" << reply->error() << ":" << reply->request().url();
-        requestJob->fail(QWebEngineUrlRequestJob::RequestFailed);
+
+      if ( !reply->isFinished() && reply->bytesAvailable() <= 0 )
         return;
+
+      if ( reply->bytesAvailable() <= 0 ) {
+        if ( reply->error() == QNetworkReply::ContentNotFoundError ) {
+          *replied = true;
+          requestJob->fail( QWebEngineUrlRequestJob::UrlNotFound );
+          return;
+        }
+        if ( reply->error() != QNetworkReply::NoError ) {
+          qDebug() << "resource handler failed:" << reply->error() << ":" << reply->request().url();
+          *replied = true;
+          requestJob->fail( QWebEngineUrlRequestJob::RequestFailed );
+          return;
+        }
       }
-      QMimeType mineType = db.mimeTypeForUrl(url);
-      QString contentType = mineType.name();
-      // Reply segment
-      requestJob->reply(contentType.toLatin1(), reply);
-    });
+
+      *replied = true;
+      requestJob->reply( contentType.toLatin1(), reply );
+    };
+
+    connect( reply, &QIODevice::readyRead, requestJob, startReply );
+    connect( reply, &QNetworkReply::finished, requestJob, startReply );
     connect(requestJob, &QObject::destroyed, reply, &QObject::deleteLater);
 }
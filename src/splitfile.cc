@@ -3,6 +3,8 @@
 
 #include "splitfile.hh"
 
+#include <cstring>
+
 
 namespace SplitFile
 {
@@ -28,6 +30,12 @@ void SplitFile::appendFile( const QString & name )
 
 void SplitFile::close()
 {
+  for( int i = 0; i < maps.size(); i++ )
+    if( maps.at( i ) )
+      files.at( i )->unmap( maps.at( i ) );
+
+  maps.clear();
+
   for( QVector< QFile * >::const_iterator i = files.begin(); i != files.end(); ++i )
   {
     (*i)->close();
@@ -55,6 +63,11 @@ bool SplitFile::open( QFile::OpenMode mode )
       return false;
     }
 
+  // Map read-only files, so that readAt() works without locking
+  if( !( mode & QIODevice::WriteOnly ) )
+    for( QVector< QFile * >::iterator i = files.begin(); i != files.end(); ++i )
+      maps.append( (*i)->size() > 0 ? (*i)->map( 0, (*i)->size() ) : nullptr );
+
   return true;
 }
 
@@ -129,4 +142,84 @@ qint64 SplitFile::pos() const
   return offsets.at( currentFile ) + files.at( currentFile )->pos();
 }
 
+qint64 SplitFile::readAt( quint64 pos, char * data, qint64 maxSize ) const
+{
+  if( offsets.isEmpty() )
+    return 0;
+
+  int fileNom;
+
+  for( fileNom = 0; fileNom < offsets.size() - 1; fileNom++ )
+    if( pos < offsets.at( fileNom + 1 ) )
+      break;
+
+  quint64 bytesReaded = 0;
+  quint64 filePos = pos - offsets.at( fileNom );
+
+  for( int i = fileNom; i < files.size() && maxSize > 0; i++, filePos = 0 )
+  {
+    qint64 size = fileSize( i );
+
+    if( (qint64)filePos >= size )
+      continue;
+
+    qint64 toRead = qMin( maxSize, size - (qint64)filePos );
+    qint64 ret;
+
+    if( i < maps.size() && maps.at( i ) )
+    {
+      memcpy( data + bytesReaded, maps.at( i ) + filePos, toRead );
+      ret = toRead;
+    }
+    else
+    {
+      QMutexLocker _( &unmappedReadMutex );
+
+      if( !files.at( i )->seek( filePos ) )
+        break;
+
+      ret = files.at( i )->read( data + bytesReaded, toRead );
+      if( ret < 0 )
+        break;
+    }
+
+    bytesReaded += ret;
+    maxSize -= ret;
+
+    if( ret < toRead )
+      break;
+  }
+  return bytesReaded;
+}
+
+QByteArray SplitFile::readAt( quint64 pos, qint64 maxSize ) const
+{
+  QByteArray data;
+  data.resize( maxSize );
+
+  qint64 ret = readAt( pos, data.data(), maxSize );
+
+  if( ret != maxSize )
+    data.resize( ret );
+
+  return data;
+}
+
+char const * SplitFile::mappedData( quint64 pos, qint64 size ) const
+{
+  for( int i = 0; i < maps.size(); i++ )
+  {
+    quint64 fileEnd = offsets.at( i ) + fileSize( i );
+
+    if( pos < fileEnd )
+    {
+      if( !maps.at( i ) || pos + size > fileEnd )
+        return nullptr;
+
+      return (char const *)maps.at( i ) + ( pos - offsets.at( i ) );
+    }
+  }
+  return nullptr;
+}
+
 } // namespace SplitFile
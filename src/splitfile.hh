@@ -2,6 +2,7 @@
 #define __SPLITFILE_HH_INCLUDED__
 
 #include <QFile>
+#include <QMutex>
 #include <QVector>
 #include <QString>
 
@@ -22,10 +23,20 @@ protected:
 
   QVector< QFile * > files;
   QVector< quint64 > offsets;
+  /// Memory mappings of the files, nullptr where mapping failed
+  QVector< uchar * > maps;
   int currentFile;
+  /// Serializes positional reads from the files which couldn't be mapped
+  mutable QMutex unmappedReadMutex;
 
   void appendFile( const QString & name );
 
+  qint64 fileSize( int fileNom ) const
+  {
+    return fileNom + 1 < offsets.size() ? offsets.at( fileNom + 1 ) - offsets.at( fileNom ) :
+                                          files.at( fileNom )->size();
+  }
+
 public:
 
   SplitFile();
@@ -44,6 +55,16 @@ public:
   bool exists() const
   { return !files.isEmpty(); }
   qint64 pos() const;
+
+  /// Reads up to maxSize bytes starting at the absolute position pos. Unlike
+  /// seek() + read(), this doesn't use the current position, so it may be
+  /// called from several threads at once.
+  qint64 readAt( quint64 pos, char * data, qint64 maxSize ) const;
+  QByteArray readAt( quint64 pos, qint64 maxSize ) const;
+
+  /// Returns a pointer to the mapped data at pos if all the size bytes lie
+  /// within a single mapped file, nullptr otherwise.
+  char const * mappedData( quint64 pos, qint64 size ) const;
 };
 
 } // namespace SplitFile
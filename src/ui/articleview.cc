@@ -29,6 +29,7 @@
 #include <QWebEngineScript>
 #include <QWebEngineScriptCollection>
 #include <QWebEngineSettings>
+#include <algorithm>
 #include <map>
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5,0,0) && QT_VERSION < QT_VERSION_CHECK(6,0,0))
@@ -47,6 +48,16 @@
 using std::map;
 using std::list;
 
+namespace {
+
+/// How many audio links of a page are prefetched at most
+int const MaxPrefetchedAudioLinks = 5;
+
+/// Memory budget of the prefetched audio of a page
+size_t const MaxPrefetchedAudioSize = 8 * 1024 * 1024;
+
+} // namespace
+
 /// AccentMarkHandler class
 ///
 /// Remove accent marks from text
@@ -399,6 +410,7 @@ void ArticleView::setGroupComboBox( GroupComboBox const * g )
 
 ArticleView::~ArticleView()
 {
+  cancelAudioPrefetch();
   cleanupTemp();
   audioPlayer->stop();
   //channel->deregisterObject(this);
@@ -576,6 +588,7 @@ void ArticleView::loadFinished( bool result )
   //the audio link click ,no need to emit pageLoaded signal
   if(result){
     emit pageLoaded( this );
+    startAudioPrefetch();
   }
   if( Utils::Url::hasQueryItem( webview->url(), "regexp" ) )
     highlightFTSResults();
@@ -706,7 +719,115 @@ void ArticleView::tryMangleWebsiteClickedUrl( QUrl & url, Contexts & contexts )
   }
 }
 
-void ArticleView::load( QUrl const & url ) { webview->load( url ); }
+void ArticleView::load( QUrl const & url )
+{
+  cancelAudioPrefetch();
+  webview->load( url );
+}
+
+void ArticleView::startAudioPrefetch()
+{
+  cancelAudioPrefetch();
+
+  if ( !cfg.preferences.prefetchAudio )
+    return;
+
+  // The preferred link first, then the rest in page order
+  QString const script = "(function(){ var links = [];"
+                         "  if(typeof(gdAudioLinks)!=\"undefined\" && gdAudioLinks.first)"
+                         "    links.push(gdAudioLinks.first);"
+                         "  document.querySelectorAll('a[href^=\"gdau:\"]').forEach(function(a){"
+                         "    links.push(a.getAttribute('href')); });"
+                         "  return links; })();";
+
+  webview->page()->runJavaScript( script, [ this, pageUrl = webview->url() ]( const QVariant & result ) {
+    if ( webview->url() != pageUrl || !cfg.preferences.prefetchAudio )
+      return; // Navigated away meanwhile
+
+    audioPrefetchQueue.clear();
+
+    for ( auto const & link : result.toList() ) {
+      QUrl url = QUrl::fromEncoded( link.toString().toUtf8() );
+
+      // Searches span all the dictionaries of the group, so they are too
+      // expensive to be made speculatively
+      if ( url.scheme() != "gdau" || url.host() == "search" || audioPrefetchQueue.contains( url ) )
+        continue;
+
+      audioPrefetchQueue.append( url );
+
+      if ( audioPrefetchQueue.size() >= MaxPrefetchedAudioLinks )
+        break;
+    }
+
+    prefetchNextAudio();
+  } );
+}
+
+void ArticleView::prefetchNextAudio()
+{
+  while ( !audioPrefetchRequest && !audioPrefetchQueue.isEmpty()
+          && prefetchedAudioSize < MaxPrefetchedAudioSize ) {
+    QUrl url = audioPrefetchQueue.takeFirst();
+
+    if ( prefetchedAudio.contains( url.toString() ) )
+      continue;
+
+    QString contentType;
+    sptr< Dictionary::DataRequest > req = articleNetMgr.getResource( url, contentType );
+
+    if ( !req )
+      continue;
+
+    audioPrefetchRequest = req;
+    audioPrefetchUrl     = url;
+
+    if ( req->isFinished() )
+      audioPrefetchFinished();
+    else
+      connect( req.get(), &Dictionary::Request::finished, this, &ArticleView::audioPrefetchFinished );
+  }
+}
+
+void ArticleView::audioPrefetchFinished()
+{
+  if ( !audioPrefetchRequest || !audioPrefetchRequest->isFinished() )
+    return; // Stray signal
+
+  sptr< Dictionary::DataRequest > req = audioPrefetchRequest;
+  audioPrefetchRequest.reset();
+
+  long size = req->dataSize();
+
+  if ( size > 0 && prefetchedAudioSize + size <= MaxPrefetchedAudioSize ) {
+    prefetchedAudio.insert( audioPrefetchUrl.toString(), req );
+    prefetchedAudioSize += size;
+  }
+
+  prefetchNextAudio();
+}
+
+void ArticleView::cancelAudioPrefetch()
+{
+  audioPrefetchQueue.clear();
+
+  if ( audioPrefetchRequest ) {
+    disconnect( audioPrefetchRequest.get(),
+                &Dictionary::Request::finished,
+                this,
+                &ArticleView::audioPrefetchFinished );
+
+    // The user may have clicked the link meanwhile, and waits for it to play
+    if ( std::find( resourceDownloadRequests.begin(), resourceDownloadRequests.end(), audioPrefetchRequest )
+         == resourceDownloadRequests.end() )
+      audioPrefetchRequest->cancel();
+
+    audioPrefetchRequest.reset();
+  }
+
+  prefetchedAudio.clear();
+  prefetchedAudioSize = 0;
+}
 
 void ArticleView::cleanupTemp()
 {
@@ -1190,6 +1311,26 @@ void ArticleView::openLink( QUrl const & url, QUrl const & ref, QString const &
 
     resourceDownloadUrl = url;
 
+    if ( url.scheme() == "gdau" ) {
+      // Play prefetched audio right away, or pick up the prefetch in flight
+      auto prefetched = prefetchedAudio.constFind( url.toString() );
+
+      if ( prefetched != prefetchedAudio.constEnd() ) {
+        resourceDownloadRequests.push_back( prefetched.value() );
+        resourceDownloadFinished();
+        return;
+      }
+
+      if ( audioPrefetchRequest && audioPrefetchUrl == url ) {
+        resourceDownloadRequests.push_back( audioPrefetchRequest );
+        connect( audioPrefetchRequest.get(),
+                 &Dictionary::Request::finished,
+                 this,
+                 &ArticleView::resourceDownloadFinished );
+        return;
+      }
+    }
+
     if ( Dictionary::WebMultimediaDownload::isAudioUrl( url ) )
     {
       sptr< Dictionary::DataRequest > req =
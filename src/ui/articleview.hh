@@ -65,6 +65,16 @@ class ArticleView: public QWidget
   /// Url of the resourceDownloadRequests
   QUrl resourceDownloadUrl;
 
+  /// Audio links of the current page still to be prefetched, in page order
+  QList< QUrl > audioPrefetchQueue;
+  /// The prefetch request in flight, if any. Only one runs at a time, so
+  /// that prefetching doesn't compete with the requests the user makes.
+  sptr< Dictionary::DataRequest > audioPrefetchRequest;
+  QUrl audioPrefetchUrl;
+  /// Finished prefetch requests, keyed by their url
+  QMap< QString, sptr< Dictionary::DataRequest > > prefetchedAudio;
+  size_t prefetchedAudioSize = 0;
+
   /// For resources opened via desktop services
   QSet< QString > desktopOpenedTempFiles;
 
@@ -348,6 +358,9 @@ private slots:
 
   void resourceDownloadFinished();
 
+  /// Stores the result of audioPrefetchRequest and starts the next one.
+  void audioPrefetchFinished();
+
   /// We handle pasting by attempting to define the word in clipboard.
   void pasteTriggered();
 
@@ -417,6 +430,17 @@ private:
   /// Attempts removing last temporary file created.
   void cleanupTemp();
 
+  /// Starts fetching the first audio links of the loaded page in the
+  /// background, if enabled in the preferences.
+  void startAudioPrefetch();
+
+  /// Starts the next queued prefetch request, unless one is running or the
+  /// memory budget is used up.
+  void prefetchNextAudio();
+
+  /// Cancels the running prefetch request and drops the prefetched data.
+  void cancelAudioPrefetch();
+
   bool eventFilter( QObject * obj, QEvent * ev );
 
   void performFindOperation( bool restart, bool backwards, bool checkHighlight = false );
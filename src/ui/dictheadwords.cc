@@ -18,7 +18,6 @@
 #include "wildcard.hh"
 #include "help.hh"
 #include <QMessageBox>
-#include <QMutexLocker>
 #include <memory>
 
 #define AUTO_APPLY_LIMIT 150000
@@ -105,6 +104,8 @@ DictHeadwords::DictHeadwords( QWidget * parent, Config::Class & cfg_, Dictionary
   connect( ui.searchModeCombo, &QComboBox::currentIndexChanged, this, &DictHeadwords::filterChangedInternal );
   connect( ui.matchCase, &QCheckBox::stateChanged, this, &DictHeadwords::filterChangedInternal );
 
+  connect( ui.jumpLine, &QLineEdit::textChanged, this, &DictHeadwords::jumpChanged );
+
   connect( ui.headersListView, &QAbstractItemView::clicked, this, &DictHeadwords::itemClicked );
 
   connect( proxy, &QAbstractItemModel::dataChanged, this, &DictHeadwords::showHeadwordsNumber );
@@ -133,6 +134,14 @@ void DictHeadwords::setup( Dictionary::Class *dict_ )
   model.swap( other );
   model->setDict( dict );
   proxy->setSourceModel( model.get() );
+
+  // Show how far a filter got while it's scanning
+  connect( model.get(), &HeadwordListModel::numberPopulated, this, &DictHeadwords::showHeadwordsNumber );
+
+  // The jump was into the previous dictionary
+  ui.jumpLine->blockSignals( true );
+  ui.jumpLine->clear();
+  ui.jumpLine->blockSignals( false );
   proxy->sort( 0 );
   filterChanged();
 
@@ -244,20 +253,24 @@ void DictHeadwords::filterChanged()
 
   QApplication::setOverrideCursor( Qt::WaitCursor );
 
-  if ( sortedWords.isEmpty() && regExp.isValid() && !regExp.pattern().isEmpty() ) {
-    const int headwordsNumber = model->totalCount();
+  // The model applies the filter to the headwords it pages in, so nothing
+  // beyond what's visible gets loaded
+  model->setFilter( regExp );
 
-    QProgressDialog progress( tr( "Loading headwords..." ), tr( "Cancel" ), 0, headwordsNumber, this );
-    progress.setWindowModality( Qt::WindowModal );
-    loadAllSortedWords( progress );
-    progress.close();
-  }
+  proxy->sort( 0 );
 
-  const auto filtered = sortedWords.filter( regExp );
+  QApplication::restoreOverrideCursor();
+
+  showHeadwordsNumber();
+}
 
-  model->addMatches( filtered );
+void DictHeadwords::jumpChanged()
+{
+  QApplication::setOverrideCursor( Qt::WaitCursor );
+
+  // Only the headwords from the prefix on get paged in
+  model->setStartPrefix( ui.jumpLine->text() );
 
-  proxy->setFilterRegularExpression( regExp );
   proxy->sort( 0 );
 
   QApplication::restoreOverrideCursor();
@@ -282,49 +295,14 @@ void DictHeadwords::autoApplyStateChanged( int state )
 
 void DictHeadwords::showHeadwordsNumber()
 {
-  ui.headersNumber->setText( tr( "Unique headwords total: %1, filtered: %2" )
-                             .arg( QString::number( model->totalCount() ), QString::number( proxy->rowCount() ) ) );
-}
-
-// TODO , the ui and the code mixed together , this is not the right way to do this. need future refactor
-void  DictHeadwords::loadAllSortedWords( QProgressDialog & progress )
-{
-  const int headwordsNumber = model->totalCount();
-
-  QMutexLocker _( &mutex );
-  if ( sortedWords.isEmpty() ) {
-    QSet< QString > allHeadwords;
-
-    int totalCount = 0;
-    for ( int i = 0; i < headwordsNumber && i < model->wordCount(); ++i ) {
-      if ( progress.wasCanceled() )
-        break;
-      progress.setValue( totalCount++ );
-
-      QVariant value = model->getRow( i );
-      if ( !value.canConvert< QString >() )
-        continue;
-
-      allHeadwords.insert( value.toString() );
-    }
-
-    // continue to write the remaining headword
-    int nodeIndex  = model->getCurrentIndex();
-    auto headwords = model->getRemainRows( nodeIndex );
-    while ( !headwords.isEmpty() ) {
-      if ( progress.wasCanceled() )
-        break;
-      allHeadwords.unite( headwords );
-
-      totalCount += headwords.size();
-      progress.setValue( totalCount );
-
-      headwords = model->getRemainRows( nodeIndex );
-    }
-
-    sortedWords = allHeadwords.values();
-    sortedWords.sort();
-  }
+  if( model->isFinish() )
+    ui.headersNumber->setText( tr( "Unique headwords total: %1, filtered: %2" )
+                               .arg( QString::number( model->totalCount() ), QString::number( proxy->rowCount() ) ) );
+  else
+    ui.headersNumber->setText( tr( "Unique headwords total: %1, filtered: %2, scanned: %3" )
+                               .arg( QString::number( model->totalCount() ),
+                                     QString::number( proxy->rowCount() ),
+                                     QString::number( model->scannedCount() ) ) );
 }
 
 void DictHeadwords::saveHeadersToFile()
@@ -358,11 +336,9 @@ void DictHeadwords::saveHeadersToFile()
 
   const int headwordsNumber = model->totalCount();
 
-  QProgressDialog progress( tr( "Export headwords..." ), tr( "Cancel" ), 0, headwordsNumber*2, this );
+  QProgressDialog progress( tr( "Export headwords..." ), tr( "Cancel" ), 0, headwordsNumber, this );
   progress.setWindowModality( Qt::WindowModal );
 
-  loadAllSortedWords( progress );
-
   // Write UTF-8 BOM
   QTextStream out( &file );
   out.setGenerateByteOrderMark( true );
@@ -371,31 +347,50 @@ void DictHeadwords::saveHeadersToFile()
   out.setCodec("UTF-8");
 #endif
 
-  QStringList filtered;
+  const QRegularExpression regExp = getFilterRegex();
+  const bool filtering            = regExp.isValid() && !regExp.pattern().isEmpty();
+
+  // Headwords are streamed page by page in the index order, which is
+  // already sorted, straight to the file
+  uint32_t position = 0;
+  bool hasMore      = true;
+  int processed     = 0;
+  QStringList page;
 
-  if ( const QRegularExpression regExp = getFilterRegex(); regExp.isValid() && !regExp.pattern().isEmpty() ) {
-    filtered = sortedWords.filter( regExp );
-  }
-  else{
-    filtered = sortedWords;
-  }
-  auto currentValue = progress.value();
-  // Write headwords
-  for ( auto const & word : filtered )
+  while( hasMore && !progress.wasCanceled() )
   {
-    if( progress.wasCanceled() )
+    page.clear();
+
+    try
+    {
+      hasMore = dict->findHeadWordsWithLenth( position, page, 10000 );
+    }
+    catch( std::exception & e )
+    {
+      gdWarning( "Headwords retrieving failed for \"%s\", reason: %s\n", dict->getName().c_str(), e.what() );
       break;
-    progress.setValue( currentValue++ );
-    QByteArray line = word.toUtf8();
+    }
 
-    //usually the headword should not contain \r \n;
-    line.replace( '\n', ' ' );
-    line.replace( '\r', ' ' );
+    for( auto const & word : qAsConst( page ) )
+    {
+      if( filtering && !regExp.match( word ).hasMatch() )
+        continue;
+
+      QByteArray line = word.toUtf8();
+
+      //usually the headword should not contain \r \n;
+      line.replace( '\n', ' ' );
+      line.replace( '\r', ' ' );
+
+      //write one line
+      out << line << '\n';
+    }
 
-    //write one line
-    out << line << Qt::endl;
+    processed += page.size();
+    progress.setValue( qMin( processed, headwordsNumber ) );
   }
 
+  out.flush();
   file.close();
 
   progress.setValue( progress.maximum() );
@@ -407,7 +402,7 @@ void DictHeadwords::saveHeadersToFile()
   else
   {
     //completed.
-    progress.setValue(headwordsNumber*2);
+    progress.setValue( headwordsNumber );
     progress.close();
     QMessageBox::information( this, "GoldenDict", tr( "Export finished" ) );
   }
@@ -43,19 +43,17 @@ protected:
 
 private:
   Ui::DictHeadwords ui;
-  QStringList sortedWords;
-  QMutex mutex;
 private slots:
   void savePos();
   void filterChangedInternal();
   QRegularExpression getFilterRegex() const;
   void filterChanged();
+  void jumpChanged();
   void exportButtonClicked();
   void okButtonClicked();
   void itemClicked( const QModelIndex & index );
   void autoApplyStateChanged( int state );
   void showHeadwordsNumber();
-  void loadAllSortedWords( QProgressDialog & progress );
   virtual void reject();
 
 signals:
@@ -98,6 +98,7 @@ void DictionaryBar::showContextMenu( QContextMenuEvent * event, bool extended )
   QAction * headwordsAction = NULL;
   QAction * editDictAction = NULL;
   QAction * openDictFolderAction = NULL;
+  QAction * compileAction = NULL;
   QString dictFilename;
 
   QAction * dictAction = actionAt( event->x(), event->y() );
@@ -125,6 +126,9 @@ void DictionaryBar::showContextMenu( QContextMenuEvent * event, bool extended )
 
         openDictFolderAction = menu.addAction( tr( "Open dictionary folder" ) );
 
+        if( pDict->getWordCount() > 0 )
+          compileAction = menu.addAction( tr( "Compile dictionary..." ) );
+
         if( !editDictionaryCommand.isEmpty() )
         {
           if( !pDict->getMainFilename().isEmpty() )
@@ -195,6 +199,17 @@ void DictionaryBar::showContextMenu( QContextMenuEvent * event, bool extended )
     return;
   }
 
+  if ( result && result == compileAction ) {
+    std::string id = dictAction->data().toString().toStdString();
+    for ( const auto & dict : allDictionaries ) {
+      if ( id == dict->getId() ) {
+        emit compileDictionary( dict.get() );
+        break;
+      }
+    }
+    return;
+  }
+
   if( result && result == editDictAction )
   {
     QString command( editDictionaryCommand );
@@ -45,6 +45,9 @@ signals:
   /// Signal for open dictionary folder from context menu
   void openDictionaryFolder( QString const & id );
 
+  /// Signal for compile dictionary command from context menu
+  void compileDictionary( Dictionary::Class * dict );
+
   /// Signal to close context menu
   void closePopupMenu();
 
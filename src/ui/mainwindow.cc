@@ -14,6 +14,7 @@
 #include "mruqmenu.hh"
 #include "gestures.hh"
 #include "dictheadwords.hh"
+#include "dict/gdc.hh"
 #include <QTextStream>
 #include <QDir>
 #include <QUrl>
@@ -26,6 +27,10 @@
 #include <QProcess>
 #include <QCryptographicHash>
 #include <QFileDialog>
+#include <QProgressDialog>
+#include <QEventLoop>
+#include <QTimer>
+#include <atomic>
 #include <QPrinter>
 #include <QPageSetupDialog>
 #include <QPrintPreviewDialog>
@@ -545,6 +550,7 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
   connect( &dictionaryBar,&DictionaryBar::showDictionaryHeadwords,this,&MainWindow::showDictionaryHeadwords);
 
   connect( &dictionaryBar, &DictionaryBar::openDictionaryFolder, this, &MainWindow::openDictionaryFolder );
+  connect( &dictionaryBar, &DictionaryBar::compileDictionary, this, &MainWindow::compileDictionary );
 
   // Favorites
 
@@ -1051,6 +1057,9 @@ void MainWindow::mousePressEvent( QMouseEvent *event)
 
 MainWindow::~MainWindow()
 {
+  // An index being built is just dropped, it gets built next time
+  cancelBackgroundIndexing();
+
   closeHeadwordsDialog();
 
   ftsIndexing.stopIndexing();
@@ -1437,7 +1446,11 @@ void MainWindow::makeDictionaries()
   ftsIndexing.stopIndexing();
   ftsIndexing.clearDictionaries();
 
-  loadDictionaries( this, isVisible(), cfg, dictionaries, dictNetMgr, false );
+  // The dictionaries which need their indices built are left out for now,
+  // so the window shows up without waiting for them
+  vector< vector< string > > deferredDictionaries;
+
+  loadDictionaries( this, isVisible(), cfg, dictionaries, dictNetMgr, false, &deferredDictionaries );
 
   //create map
   dictMap = Dictionary::dictToMap(dictionaries);
@@ -1453,6 +1466,128 @@ void MainWindow::makeDictionaries()
 
   updateStatusLine();
   updateGroupList();
+
+  if ( !deferredDictionaries.empty() )
+    startBackgroundIndexing( deferredDictionaries );
+}
+
+void MainWindow::startBackgroundIndexing( vector< vector< string > > const & deferredDictionaries )
+{
+  if( backgroundLoad )
+    return;
+
+  backgroundLoad = new LoadDictionaries( cfg, deferredDictionaries );
+
+  connect( backgroundLoad, &LoadDictionaries::indexingDictionarySignal,
+           this, &MainWindow::showIndexingDictionaryName );
+
+  // Each dictionary is put to use as soon as its index is ready. One which
+  // arrives after the indexing was cancelled is of no use anymore.
+  connect( backgroundLoad, &LoadDictionaries::dictionaryLoaded, this,
+           [ this ]( sptr< Dictionary::Class > const & dictionary ) {
+    if( backgroundLoad )
+      addIndexedDictionaries( { dictionary } );
+  } );
+
+  connect( backgroundLoad, &QThread::finished, this, &MainWindow::backgroundIndexingFinished );
+
+  backgroundLoad->start( QThread::LowPriority );
+}
+
+void MainWindow::finishBackgroundIndexing()
+{
+  if( !backgroundLoad )
+    return;
+
+  if( !backgroundLoad->isFinished() )
+  {
+    ::Initializing init( this, true );
+
+    connect( backgroundLoad, &LoadDictionaries::indexingDictionarySignal, &init, &Initializing::indexing );
+
+    QEventLoop localLoop;
+
+    connect( backgroundLoad, &QThread::finished, &localLoop, &QEventLoop::quit );
+
+    if( !backgroundLoad->isFinished() )
+      localLoop.exec();
+  }
+
+  backgroundIndexingFinished();
+}
+
+void MainWindow::cancelBackgroundIndexing()
+{
+  if( !backgroundLoad )
+    return;
+
+  // Each format writes its index aside and only puts it in place once
+  // complete, so an interrupted one is simply built again next time
+  backgroundLoad->requestInterruption();
+  backgroundLoad->wait();
+
+  delete backgroundLoad;
+  backgroundLoad = nullptr;
+
+  mainStatusBar->setBackgroundMessage( QString() );
+}
+
+void MainWindow::backgroundIndexingFinished()
+{
+  if( !backgroundLoad )
+    return;
+
+  LoadDictionaries * load = backgroundLoad;
+  backgroundLoad = nullptr;
+
+  load->wait();
+
+  mainStatusBar->setBackgroundMessage( QString() );
+
+  if( load->getExceptionText().size() )
+    gdWarning( "Background indexing failed: %s\n", load->getExceptionText().c_str() );
+  else
+    addIndexedDictionaries( load->getDictionaries() ); // Those not handed over one by one
+
+  load->deleteLater();
+}
+
+void MainWindow::addIndexedDictionaries( std::vector< sptr< Dictionary::Class > > const & indexed )
+{
+  // The dictionaries in use stay as they are, along with whatever dialogs
+  // use them. The new ones are just added to them.
+  std::vector< sptr< Dictionary::Class > > added;
+
+  for( unsigned x = 0; x < indexed.size(); x++ )
+  {
+    if( dictMap.contains( indexed[ x ]->getId() ) )
+      continue; // E.g. another subbook of an EPWING book, loaded already
+
+    indexed[ x ]->setFTSParameters( cfg.preferences.fts );
+    indexed[ x ]->setSynonymSearchEnabled( cfg.preferences.synonymSearchEnabled );
+
+    added.push_back( indexed[ x ] );
+  }
+
+  if( added.empty() )
+    return;
+
+  doDeferredInit( added );
+
+  dictionaries.insert( dictionaries.end(), added.begin(), added.end() );
+  dictMap = Dictionary::dictToMap(dictionaries);
+
+  ftsIndexing.stopIndexing();
+  ftsIndexing.clearDictionaries();
+  ftsIndexing.setDictionaries( dictionaries );
+  ftsIndexing.doIndexing();
+
+  updateGroupList();
+
+  scanPopup->refresh();
+
+  updateSuggestionList();
+  updateStatusLine();
 }
 
 void MainWindow::updateStatusLine()
@@ -2049,6 +2184,12 @@ void MainWindow::updatePronounceAvailability()
 
 void MainWindow::editDictionaries( unsigned editDictionaryGroup )
 {
+  if( compilingDictionary )
+    return;
+
+  // The dialog may rescan the dictionaries, which mustn't race the indexing
+  finishBackgroundIndexing();
+
   hotkeyWrapper.reset(); // No hotkeys while we're editing dictionaries
   closeHeadwordsDialog();
   closeFullTextSearchDialog();
@@ -3415,6 +3556,12 @@ void MainWindow::on_saveArticle_triggered()
 
 void MainWindow::on_rescanFiles_triggered()
 {
+  if( compilingDictionary )
+    return;
+
+  // Everything gets loaded and indexed anew
+  cancelBackgroundIndexing();
+
   hotkeyWrapper.reset(); // No hotkeys while we're editing dictionaries
   closeHeadwordsDialog();
   closeFullTextSearchDialog();
@@ -4180,6 +4327,127 @@ void MainWindow::editDictionary( Dictionary::Class * dict )
   }
 }
 
+void MainWindow::compileDictionary( Dictionary::Class * dict )
+{
+  // The dictionary is held on to until the compilation is over, whatever
+  // happens to the set of dictionaries meanwhile
+  sptr< Dictionary::Class > source;
+
+  for( unsigned x = 0; x < dictionaries.size(); x++ )
+  {
+    if( dictionaries[ x ].get() == dict )
+    {
+      source = dictionaries[ x ];
+      break;
+    }
+  }
+
+  if( !source || compilingDictionary )
+    return;
+
+  QString fileName = QFileDialog::getSaveFileName( this, tr( "Compile dictionary" ),
+                                                   QDir( source->getContainingFolder() )
+                                                     .filePath( QString::fromUtf8( source->getName().c_str() ) + ".gdc" ),
+                                                   tr( "Compiled dictionaries (*.gdc)" ) );
+  if( fileName.isEmpty() )
+    return;
+
+  // A dictionary being used is never overwritten
+  for( unsigned x = 0; x < dictionaries.size(); x++ )
+  {
+    vector< string > const & files = dictionaries[ x ]->getDictionaryFilenames();
+
+    for( unsigned y = 0; y < files.size(); y++ )
+    {
+      if( QFileInfo( QString::fromUtf8( files[ y ].c_str() ) ) == QFileInfo( fileName ) )
+      {
+        QMessageBox::warning( this, "GoldenDict",
+                              tr( "The file %1 belongs to the dictionary \"%2\", which is in use. "
+                                  "Please choose another file name." )
+                                .arg( QDir::toNativeSeparators( fileName ),
+                                      QString::fromUtf8( dictionaries[ x ]->getName().c_str() ) ) );
+        return;
+      }
+    }
+  }
+
+  QProgressDialog progress( tr( "Compiling dictionary..." ), tr( "Cancel" ), 0, source->getWordCount(), this );
+  progress.setWindowModality( Qt::WindowModal );
+
+  // The compilation runs on a thread of its own, with the GUI one only
+  // showing the progress. It mustn't take a thread of the global pool, since
+  // it waits for the articles which are made there. The dictionaries can't
+  // be replaced until it's done.
+  compilingDictionary = true;
+
+  struct Compilation
+  {
+    std::atomic< unsigned long > done{ 0 };
+    std::atomic< bool > cancelled{ false };
+    bool finished = false;
+    QString error;
+  };
+
+  auto compilation = std::make_shared< Compilation >();
+
+  string const outputName = QDir::toNativeSeparators( fileName ).toStdString();
+
+  QThread * compiler = QThread::create( [ source, outputName, compilation ]() {
+    try
+    {
+      compilation->finished = Gdc::compile( *source, outputName, [ compilation ]( unsigned long n ) {
+        compilation->done = n;
+        return !compilation->cancelled;
+      } );
+    }
+    catch( std::exception & e )
+    {
+      compilation->error = QString::fromUtf8( e.what() );
+    }
+  } );
+
+  connect( &progress, &QProgressDialog::canceled, this, [ compilation ]() {
+    compilation->cancelled = true;
+  } );
+
+  QTimer progressTimer;
+  connect( &progressTimer, &QTimer::timeout, this, [ &progress, compilation ]() {
+    if( !progress.wasCanceled() )
+      progress.setValue( qMin< unsigned long >( compilation->done, progress.maximum() ) );
+  } );
+  progressTimer.start( 100 );
+
+  QEventLoop localLoop;
+
+  connect( compiler, &QThread::finished, &localLoop, &QEventLoop::quit );
+
+  compiler->start( QThread::LowPriority );
+
+  if( !compiler->isFinished() )
+    localLoop.exec();
+
+  // The loop also ends when the application quits. The compilation then
+  // stops shortly, even while waiting for an article.
+  compilation->cancelled = true;
+  compiler->wait();
+  delete compiler;
+
+  bool finished = compilation->finished;
+  QString const & error = compilation->error;
+
+  progressTimer.stop();
+  progress.close();
+
+  compilingDictionary = false;
+
+  if( !error.isEmpty() )
+    QMessageBox::critical( this, "GoldenDict", tr( "Failed to compile the dictionary: %1" ).arg( error ) );
+  else
+  if( finished )
+    QMessageBox::information( this, "GoldenDict",
+                              tr( "The dictionary was compiled. Add its folder to the dictionary paths to use it." ) );
+}
+
 void MainWindow::openDictionaryFolder( const QString & id )
 {
   for( unsigned x = 0; x < dictionaries.size(); x++ )
@@ -4233,6 +4501,10 @@ void MainWindow::foundDictsContextMenuRequested( const QPoint &pos )
 
       QAction * openDictFolderAction = menu.addAction( tr( "Open dictionary folder" ) );
 
+      QAction * compileAction = NULL;
+      if( pDict->getWordCount() > 0 )
+        compileAction = menu.addAction( tr( "Compile dictionary..." ) );
+
       QAction * editAction = NULL;
 
       QString dictFilename = pDict->getMainFilename();
@@ -4264,6 +4536,11 @@ void MainWindow::foundDictsContextMenuRequested( const QPoint &pos )
         openDictionaryFolder( id );
       }
       else
+      if( result && result == compileAction )
+      {
+        compileDictionary( pDict );
+      }
+      else
       if( result && result == editAction )
       {
         editDictionary( pDict );
@@ -4385,6 +4662,11 @@ void MainWindow::showFTSIndexingName( QString const & name )
     mainStatusBar->setBackgroundMessage( tr( "Now indexing for full-text search: " ) + name );
 }
 
+void MainWindow::showIndexingDictionaryName( QString const & name )
+{
+  mainStatusBar->setBackgroundMessage( tr( "Indexing dictionary: %1" ).arg( name ) );
+}
+
 QString MainWindow::unescapeTabHeader(QString const & header )
 {
   // Reset table header to original headword
@@ -46,6 +46,8 @@
 using std::string;
 using std::vector;
 
+class LoadDictionaries;
+
 class MainWindow: public QMainWindow, public DataCommitter
 {
   Q_OBJECT
@@ -168,6 +170,13 @@ private:
 
   FTS::FtsIndexing ftsIndexing;
 
+  /// Builds the indices which were missing on startup, or nullptr
+  LoadDictionaries * backgroundLoad = nullptr;
+
+  /// Set while a dictionary is being compiled, the dictionaries can't be
+  /// replaced then
+  bool compilingDictionary = false;
+
   FTS::FullTextSearchDialog * ftsDlg;
 
   QIcon starIcon, blueStarIcon;
@@ -193,6 +202,15 @@ private:
   void applyProxySettings();
   void setupNetworkCache( int maxSize );
   void makeDictionaries();
+  /// Starts building the missing indices left out by makeDictionaries(),
+  /// loading just those dictionaries, each given by its files
+  void startBackgroundIndexing( vector< vector< string > > const & deferredDictionaries );
+  /// Waits for the background indexing, if any, and puts its result to use
+  void finishBackgroundIndexing();
+  /// Stops the background indexing, if any, dropping its result
+  void cancelBackgroundIndexing();
+  /// Adds the dictionaries indexed in the background to the ones in use
+  void addIndexedDictionaries( std::vector< sptr< Dictionary::Class > > const & );
   void updateStatusLine();
   void updateGroupList();
   void updateDictionaryBar();
@@ -285,8 +303,15 @@ private slots:
 
   void editDictionary ( Dictionary::Class * dict );
 
+  /// Compiles the dictionary into a .gdc file chosen by the user
+  void compileDictionary( Dictionary::Class * dict );
+
   void showFTSIndexingName( QString const & name );
 
+  void showIndexingDictionaryName( QString const & name );
+
+  void backgroundIndexingFinished();
+
   void handleAddToFavoritesButton();
 
   void addCurrentTabToFavorites();
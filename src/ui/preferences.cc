@@ -239,6 +239,7 @@ Preferences::Preferences( QWidget * parent, Config::Class & cfg_ ):
 
   ui.pronounceOnLoadMain->setChecked( p.pronounceOnLoadMain );
   ui.pronounceOnLoadPopup->setChecked( p.pronounceOnLoadPopup );
+  ui.prefetchAudio->setChecked( p.prefetchAudio );
 
   ui.internalPlayerBackend->addItems( Config::InternalPlayerBackend::nameList() );
 
@@ -426,6 +427,7 @@ Config::Preferences Preferences::getPreferences()
 
   p.pronounceOnLoadMain = ui.pronounceOnLoadMain->isChecked();
   p.pronounceOnLoadPopup = ui.pronounceOnLoadPopup->isChecked();
+  p.prefetchAudio = ui.prefetchAudio->isChecked();
   p.useInternalPlayer = ui.useInternalPlayer->isChecked();
   p.internalPlayerBackend.setUiName( ui.internalPlayerBackend->currentText() );
   p.audioPlaybackProgram = ui.audioPlaybackProgram->text();
@@ -2,9 +2,12 @@
  * Part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
 
 #include "wordfinder.hh"
+#include "btreeidx.hh"
 #include "folding.hh"
 #include "wstring_qt.hh"
+#include <algorithm>
 #include <map>
+#include <QtConcurrent>
 #include "gddebug.hh"
 
 using std::vector;
@@ -17,12 +20,18 @@ using std::pair;
 WordFinder::WordFinder( QObject * parent ):
   QObject( parent ), searchInProgress( false ),
   updateResultsTimer( this ),
-  searchQueued( false )
+  searchQueued( false ),
+  alternateWritingsPending( false )
 {
   updateResultsTimer.setInterval( 1000 ); // We use a one second update timer
   updateResultsTimer.setSingleShot( true );
 
   connect( &updateResultsTimer, &QTimer::timeout, this, &WordFinder::updateResults, Qt::QueuedConnection );
+
+  connect( &alternateWritingsWatcher,
+           &QFutureWatcher< AlternateWritings >::finished,
+           this,
+           &WordFinder::alternateWritingsReady );
 }
 
 WordFinder::~WordFinder()
@@ -124,20 +133,55 @@ void WordFinder::startSearch()
   searchQueued = false;
   searchInProgress = true;
 
-  // Gather all writings of the word
+  // The word as typed is searched for right away, its alternate writings
+  // join the search when they are ready
 
   if ( allWordWritings.size() != 1 )
     allWordWritings.resize( 1 );
   
   allWordWritings[ 0 ] = gd::toWString( inputWord );
 
-  for( size_t x = 0; x < inputDicts->size(); ++x )
+  prepareFoldedWritings();
+
+  // Prefix searches for the word as typed are remembered, so the next
+  // keystroke could be answered from their results. Wildcards don't narrow
+  // down this way.
+
+  cacheableRequests.clear();
+
+  wstring const & word = allWordWritings[ 0 ];
+  bool const cacheable = ( searchType == PrefixMatch || searchType == ExpressionMatch )
+                         && word.find_first_of( U"*?[]" ) == wstring::npos;
+
+  wstring folded;
+
+  if ( cacheable )
   {
-    vector< wstring > writings = (*inputDicts)[ x ]->getAlternateWritings( allWordWritings[ 0 ] );
+    folded = Folding::apply( word );
+    if ( folded.empty() )
+      folded = Folding::applyWhitespaceOnly( word );
 
-    allWordWritings.insert( allWordWritings.end(), writings.begin(), writings.end() );
+    if ( recentSearches.size() >= 16 )
+      recentSearches.pop_back();
+
+    recentSearches.push_front( RecentSearch() );
+    recentSearches.front().folded = folded;
+    recentSearches.front().maxResults = requestedMaxResults;
   }
 
+  queueSearches( 0, cacheable ? &folded : nullptr );
+
+  alternateWritingsPending = true;
+
+  startAlternateWritings();
+
+  // Handle any requests finished already
+
+  requestFinished();
+}
+
+void WordFinder::queueSearches( size_t firstWriting, wstring const * folded )
+{
   // Query each dictionary for all word writings
 
   for( size_t x = 0; x < inputDicts->size(); ++x )
@@ -145,15 +189,26 @@ void WordFinder::startSearch()
     if ( ( (*inputDicts)[ x ]->getFeatures() & requestedFeatures ) != requestedFeatures )
       continue;
 
-    for( size_t y = 0; y < allWordWritings.size(); ++y )
+    for( size_t y = firstWriting; y < allWordWritings.size(); ++y )
     {
       try
       {
-        sptr< Dictionary::WordSearchRequest > sr =
-          ( searchType == PrefixMatch || searchType == ExpressionMatch ) ?
+        sptr< Dictionary::WordSearchRequest > sr;
+
+        if ( folded && y == 0 )
+          sr = findInRecentSearches( *( *inputDicts )[ x ], *folded );
+
+        if ( !sr )
+        {
+          sr = ( searchType == PrefixMatch || searchType == ExpressionMatch ) ?
             (*inputDicts)[ x ]->prefixMatch( allWordWritings[ y ], requestedMaxResults ) :
             (*inputDicts)[ x ]->stemmedMatch( allWordWritings[ y ], stemmedMinLength, stemmedMaxSuffixVariation, requestedMaxResults );
 
+          if ( folded && y == 0
+               && dynamic_cast< BtreeIndexing::BtreeDictionary * >( ( *inputDicts )[ x ].get() ) )
+            cacheableRequests[ sr.get() ] = ( *inputDicts )[ x ]->getId();
+        }
+
         connect( sr.get(), &Dictionary::Request::finished, this, &WordFinder::requestFinished, Qt::QueuedConnection );
 
         queuedRequests.push_back( sr );
@@ -165,16 +220,211 @@ void WordFinder::startSearch()
       }
     }
   }
+}
 
-  // Handle any requests finished already
+void WordFinder::startAlternateWritings()
+{
+  // Only one job runs at a time. When it's done, this is called again.
+  if ( alternateWritingsWatcher.isRunning() )
+    return;
+
+  wstring const word = allWordWritings[ 0 ];
+
+  vector< wstring > writings;
+  vector< sptr< Dictionary::Class > > missing;
+
+  for( auto const & dict : *inputDicts )
+  {
+    auto cached = writingsCacheIndex.find( std::make_pair( dict->getId(), word ) );
+
+    if ( cached == writingsCacheIndex.end() )
+    {
+      missing.push_back( dict );
+      continue;
+    }
+
+    writingsCache.splice( writingsCache.begin(), writingsCache, cached->second );
+
+    writings.insert( writings.end(), cached->second->writings.begin(), cached->second->writings.end() );
+  }
+
+  if ( missing.empty() )
+  {
+    addAlternateWritings( writings );
+    return;
+  }
+
+  alternateWritingsJobWord = word;
+  alternateWritingsJobDicts.clear();
+
+  for( auto const & dict : missing )
+    alternateWritingsJobDicts.push_back( dict->getId() );
+
+  alternateWritingsWatcher.setFuture( QtConcurrent::run( [ missing, word ]() {
+    AlternateWritings result;
+    result.reserve( missing.size() );
+
+    for( auto const & dict : missing )
+    {
+      try
+      {
+        result.push_back( dict->getAlternateWritings( word ) );
+      }
+      catch( std::exception & e )
+      {
+        gdWarning( "Alternate writings error (%s) in \"%s\"\n", e.what(), dict->getName().c_str() );
+        result.emplace_back();
+      }
+    }
+
+    return result;
+  } ) );
+}
+
+void WordFinder::alternateWritingsReady()
+{
+  AlternateWritings const result = alternateWritingsWatcher.result();
+
+  for( size_t x = 0; x < result.size() && x < alternateWritingsJobDicts.size(); ++x )
+  {
+    auto key = std::make_pair( alternateWritingsJobDicts[ x ], alternateWritingsJobWord );
+
+    if ( writingsCacheIndex.count( key ) )
+      continue;
+
+    writingsCache.push_front( CachedWritings{ key.first, key.second, result[ x ] } );
+    writingsCacheIndex[ key ] = writingsCache.begin();
+
+    if ( writingsCache.size() > 4096 )
+    {
+      writingsCacheIndex.erase( std::make_pair( writingsCache.back().dictId, writingsCache.back().word ) );
+      writingsCache.pop_back();
+    }
+  }
+
+  alternateWritingsJobDicts.clear();
+
+  // The writings just made are all in the cache now, unless the search has
+  // moved on to another word meanwhile
+
+  if ( searchInProgress && alternateWritingsPending )
+    startAlternateWritings();
+}
+
+void WordFinder::addAlternateWritings( vector< wstring > const & writings )
+{
+  alternateWritingsPending = false;
+
+  if ( !writings.empty() )
+  {
+    size_t const firstNew = allWordWritings.size();
+
+    allWordWritings.insert( allWordWritings.end(), writings.begin(), writings.end() );
+
+    prepareFoldedWritings();
+
+    // The results merged so far were ranked against the word as typed only
+    for( auto & result : resultsIndex )
+      result.second->rank = rankResult( result.first );
+
+    queueSearches( firstNew );
+  }
+
+  // Handle any requests finished already. The search may also have been
+  // waiting just for us.
 
   requestFinished();
 }
 
+sptr< Dictionary::WordSearchRequest > WordFinder::findInRecentSearches( Dictionary::Class & dict,
+                                                                       wstring const & folded )
+{
+  auto btreeDict = dynamic_cast< BtreeIndexing::BtreeDictionary * >( &dict );
+
+  if ( !btreeDict || !btreeDict->canRefinePrefixMatches() )
+    return {};
+
+  string const id = dict.getId();
+
+  // The first entry is the current search itself
+  auto search = recentSearches.begin();
+
+  // Prefer the same query, or else the longest one it extends
+
+  CachedResults const * best = nullptr;
+  wstring::size_type bestSize = 0;
+  bool sameQuery = false;
+
+  for( ++search; search != recentSearches.end(); ++search )
+  {
+    if ( search->maxResults != requestedMaxResults || search->folded.size() > folded.size()
+         || folded.compare( 0, search->folded.size(), search->folded ) )
+      continue;
+
+    auto results = search->results.find( id );
+    if ( results == search->results.end() )
+      continue;
+
+    if ( search->folded.size() == folded.size() )
+    {
+      best = &results->second;
+      sameQuery = true;
+      break;
+    }
+
+    // A shorter query would only have all our results if it wasn't cut short
+    if ( results->second.complete && ( !best || search->folded.size() > bestSize ) )
+    {
+      best = &results->second;
+      bestSize = search->folded.size();
+    }
+  }
+
+  if ( !best )
+    return {};
+
+  auto sr = std::make_shared< Dictionary::WordSearchRequestInstant >();
+  vector< Dictionary::WordMatch > & matches = sr->getMatches();
+
+  if ( sameQuery )
+    matches = best->matches;
+  else
+  {
+    for( auto const & match : best->matches )
+      if ( BtreeIndexing::BtreeDictionary::isPrefixMatchOf( match.word, folded ) )
+        matches.push_back( match );
+  }
+
+  CachedResults & saved = recentSearches.front().results[ id ];
+  saved.matches = matches;
+  saved.complete = best->complete;
+
+  return sr;
+}
+
+void WordFinder::cacheRequestResults( Dictionary::WordSearchRequest & req )
+{
+  auto i = cacheableRequests.find( &req );
+
+  if ( i == cacheableRequests.end() )
+    return;
+
+  // Results of the failed requests aren't reliable enough to be reused
+  if ( searchInProgress && !recentSearches.empty() && req.getErrorString().isEmpty() )
+  {
+    CachedResults & saved = recentSearches.front().results[ i->second ];
+    saved.matches = req.getAllMatches();
+    saved.complete = !req.isUncertain() && saved.matches.size() < requestedMaxResults;
+  }
+
+  cacheableRequests.erase( i );
+}
+
 void WordFinder::cancel()
 {
   searchQueued = false;
   searchInProgress = false;
+  alternateWritingsPending = false;
   
   cancelSearches();
 }
@@ -184,6 +434,15 @@ void WordFinder::clear()
   cancel();
   queuedRequests.clear();
   finishedRequests.clear();
+
+  // The dictionaries are likely about to change
+  alternateWritingsWatcher.waitForFinished();
+  alternateWritingsJobDicts.clear();
+  writingsCache.clear();
+  writingsCacheIndex.clear();
+
+  recentSearches.clear();
+  cacheableRequests.clear();
 }
 
 void WordFinder::requestFinished()
@@ -196,6 +455,8 @@ void WordFinder::requestFinished()
   {
     if ( (*i)->isFinished() )
     {
+      cacheRequestResults( **i );
+
       if ( searchInProgress && !(*i)->getErrorString().isEmpty() )
         searchErrorString = tr( "Failed to query some dictionaries." );
 
@@ -287,6 +548,143 @@ bool hasSurroundedWithWs( wstring const & haystack, wstring const & needle,
 
 }
 
+void WordFinder::prepareFoldedWritings()
+{
+  foldedWritings.clear();
+  foldedWritings.reserve( allWordWritings.size() );
+
+  for( auto const & writing : allWordWritings )
+  {
+    FoldedWriting f;
+
+    if ( searchType == StemmedMatch )
+      f.target = Folding::apply( writing );
+    else
+    {
+      f.target = Folding::applySimpleCaseOnly( writing );
+      f.targetNoFullCase = Folding::applyFullCaseOnly( f.target );
+      f.targetNoDia = Folding::applyDiacriticsOnly( f.targetNoFullCase );
+      f.targetNoPunct = Folding::applyPunctOnly( f.targetNoDia );
+      f.targetNoWs = Folding::applyWhitespaceOnly( f.targetNoPunct );
+    }
+
+    foldedWritings.push_back( std::move( f ) );
+  }
+}
+
+int WordFinder::rankResult( wstring const & lowerCased ) const
+{
+  int bestRank = INT_MAX;
+
+  if ( searchType == StemmedMatch )
+  {
+    // Handling stemmed matches
+
+    // We use two factors -- first is the number of characters strings share
+    // in their beginnings, and second, the length of the strings. Here we assign
+    // only the first one, storing it in rank. Then we sort the results using
+    // SortByRankAndLength.
+    wstring resultFolded = Folding::apply( lowerCased );
+
+    for( auto const & writing : foldedWritings )
+    {
+      int charsInCommon = 0;
+
+      for( wchar const * t = writing.target.c_str(), * r = resultFolded.c_str();
+           *t && *t == *r; ++t, ++r, ++charsInCommon ) ;
+
+      int rank = -charsInCommon; // Negated so the lesser-than
+                                 // comparison would yield right
+                                 // results.
+
+      if ( bestRank > rank )
+        bestRank = rank; // We store the best rank of any writing
+    }
+
+    return bestRank;
+  }
+
+  if ( searchType != PrefixMatch )
+    return bestRank;
+
+  /// Assign each result a category, storing it in the rank's field
+
+  enum Category
+  {
+    ExactMatch,
+    ExactNoFullCaseMatch,
+    ExactNoDiaMatch,
+    ExactNoPunctMatch,
+    ExactNoWsMatch,
+    ExactInsideMatch,
+    ExactNoDiaInsideMatch,
+    ExactNoPunctInsideMatch,
+    PrefixMatch,
+    PrefixNoDiaMatch,
+    PrefixNoPunctMatch,
+    PrefixNoWsMatch,
+    WorstMatch,
+    Multiplier = 256 // Categories should be multiplied by Multiplier
+  };
+
+  // The result's folded forms don't depend on the writing, so they are
+  // computed just once
+  wstring resultNoFullCase = Folding::applyFullCaseOnly( lowerCased );
+  wstring resultNoDia = Folding::applyDiacriticsOnly( resultNoFullCase );
+  wstring resultNoPunct = Folding::applyPunctOnly( resultNoDia );
+  wstring resultNoWs = Folding::applyWhitespaceOnly( resultNoPunct );
+
+  for( auto const & writing : foldedWritings )
+  {
+    wstring::size_type matchPos = 0;
+
+    int rank;
+
+    if ( lowerCased == writing.target )
+      rank = ExactMatch * Multiplier;
+    else
+    if ( resultNoFullCase == writing.targetNoFullCase )
+      rank = ExactNoFullCaseMatch * Multiplier;
+    else
+    if ( resultNoDia == writing.targetNoDia )
+      rank = ExactNoDiaMatch * Multiplier;
+    else
+    if ( resultNoPunct == writing.targetNoPunct )
+      rank = ExactNoPunctMatch * Multiplier;
+    else
+    if ( resultNoWs == writing.targetNoWs )
+      rank = ExactNoWsMatch * Multiplier;
+    else
+    if ( hasSurroundedWithWs( lowerCased, writing.target, matchPos ) )
+      rank = ExactInsideMatch * Multiplier + matchPos;
+    else
+    if ( hasSurroundedWithWs( resultNoDia, writing.targetNoDia, matchPos ) )
+      rank = ExactNoDiaInsideMatch * Multiplier + matchPos;
+    else
+    if ( hasSurroundedWithWs( resultNoPunct, writing.targetNoPunct, matchPos ) )
+      rank = ExactNoPunctInsideMatch * Multiplier + matchPos;
+    else
+    if ( lowerCased.size() > writing.target.size() && lowerCased.compare( 0, writing.target.size(), writing.target ) == 0 )
+      rank = PrefixMatch * Multiplier + saturated( lowerCased.size() );
+    else
+    if ( resultNoDia.size() > writing.targetNoDia.size() && resultNoDia.compare( 0, writing.targetNoDia.size(), writing.targetNoDia ) == 0 )
+      rank = PrefixNoDiaMatch * Multiplier + saturated( lowerCased.size() );
+    else
+    if ( resultNoPunct.size() > writing.targetNoPunct.size() && resultNoPunct.compare( 0, writing.targetNoPunct.size(), writing.targetNoPunct ) == 0 )
+      rank = PrefixNoPunctMatch * Multiplier + saturated( lowerCased.size() );
+    else
+    if ( resultNoWs.size() > writing.targetNoWs.size() && resultNoWs.compare( 0, writing.targetNoWs.size(), writing.targetNoWs ) == 0 )
+      rank = PrefixNoWsMatch * Multiplier + saturated( lowerCased.size() );
+    else
+      rank = WorstMatch * Multiplier;
+
+    if ( bestRank > rank )
+      bestRank = rank; // We store the best rank of any writing
+  }
+
+  return bestRank;
+}
+
 void WordFinder::updateResults()
 {
   if ( !searchInProgress )
@@ -297,6 +695,9 @@ void WordFinder::updateResults()
 
   wstring original = Folding::applySimpleCaseOnly( allWordWritings[ 0 ] );
 
+  // Only the requests finished since the last update are here, and each of
+  // their matches is folded and ranked once, when it gets merged in
+
   for( list< sptr< Dictionary::WordSearchRequest > >::iterator i =
          finishedRequests.begin(); i != finishedRequests.end(); )
   {
@@ -319,7 +720,7 @@ void WordFinder::updateResults()
               break;
           }
           else
-          if( lowerCased == Folding::applySimpleCaseOnly( allWordWritings[ ws ] ) )
+          if( lowerCased == foldedWritings[ ws ].target )
             break;
         }
 
@@ -350,7 +751,7 @@ void WordFinder::updateResults()
         resultsArray.push_back( OneResult() );
 
         resultsArray.back().word = match;
-        resultsArray.back().rank = INT_MAX;
+        resultsArray.back().rank = rankResult( insertResult.first->first );
         resultsArray.back().wasSuggested = ( weight != 0 );
 
         insertResult.first->second = --resultsArray.end();
@@ -359,147 +760,37 @@ void WordFinder::updateResults()
     finishedRequests.erase( i++ );
   }
 
-  size_t maxSearchResults = 500;
+  size_t maxSearchResults = searchType == StemmedMatch ? 15 : 500;
 
-  if ( resultsArray.size() )
-  {
-    if ( searchType == PrefixMatch )
-    {
-      /// Assign each result a category, storing it in the rank's field
-  
-      enum Category
-      {
-        ExactMatch,
-        ExactNoFullCaseMatch,
-        ExactNoDiaMatch,
-        ExactNoPunctMatch,
-        ExactNoWsMatch,
-        ExactInsideMatch,
-        ExactNoDiaInsideMatch,
-        ExactNoPunctInsideMatch,
-        PrefixMatch,
-        PrefixNoDiaMatch,
-        PrefixNoPunctMatch,
-        PrefixNoWsMatch,
-        WorstMatch,
-        Multiplier = 256 // Categories should be multiplied by Multiplier
-      };
-
-      for( unsigned wr = 0; wr < allWordWritings.size(); ++wr )
-      {
-        wstring target = Folding::applySimpleCaseOnly( allWordWritings[ wr ] );
-        wstring targetNoFullCase = Folding::applyFullCaseOnly( target );
-        wstring targetNoDia = Folding::applyDiacriticsOnly( targetNoFullCase );
-        wstring targetNoPunct = Folding::applyPunctOnly( targetNoDia );
-        wstring targetNoWs = Folding::applyWhitespaceOnly( targetNoPunct );
-    
-        wstring::size_type matchPos = 0;
-    
-        for( ResultsIndex::const_iterator i = resultsIndex.begin(), j = resultsIndex.end();
-             i != j; ++i )
-        {
-          wstring resultNoFullCase, resultNoDia, resultNoPunct, resultNoWs;
+  // Only the best maxSearchResults results are shown, so there's no need to
+  // sort the rest of them
 
-          int rank;
-          
-          if ( i->first == target )
-            rank = ExactMatch * Multiplier;
-          else
-          if ( ( resultNoFullCase = Folding::applyFullCaseOnly( i->first ) ) == targetNoFullCase )
-            rank = ExactNoFullCaseMatch * Multiplier;
-          else
-          if ( ( resultNoDia = Folding::applyDiacriticsOnly( resultNoFullCase ) ) == targetNoDia )
-            rank = ExactNoDiaMatch * Multiplier;
-          else
-          if ( ( resultNoPunct = Folding::applyPunctOnly( resultNoDia ) ) == targetNoPunct )
-            rank = ExactNoPunctMatch * Multiplier;
-          else
-          if ( ( resultNoWs = Folding::applyWhitespaceOnly( resultNoPunct ) ) == targetNoWs )
-            rank = ExactNoWsMatch * Multiplier;
-          else
-          if ( hasSurroundedWithWs( i->first, target, matchPos ) )
-            rank = ExactInsideMatch * Multiplier + matchPos;
-          else
-          if ( hasSurroundedWithWs( resultNoDia, targetNoDia, matchPos ) )
-            rank = ExactNoDiaInsideMatch * Multiplier + matchPos;
-          else
-          if ( hasSurroundedWithWs( resultNoPunct, targetNoPunct, matchPos ) )
-            rank = ExactNoPunctInsideMatch * Multiplier + matchPos;
-          else
-          if ( i->first.size() > target.size() && i->first.compare( 0, target.size(), target ) == 0 )
-            rank = PrefixMatch * Multiplier + saturated( i->first.size() );
-          else
-          if ( resultNoDia.size() > targetNoDia.size() && resultNoDia.compare( 0, targetNoDia.size(), targetNoDia ) == 0 )
-            rank = PrefixNoDiaMatch * Multiplier + saturated( i->first.size() );
-          else
-          if ( resultNoPunct.size() > targetNoPunct.size() && resultNoPunct.compare( 0, targetNoPunct.size(), targetNoPunct ) == 0 )
-            rank = PrefixNoPunctMatch * Multiplier + saturated( i->first.size() );
-          else
-          if ( resultNoWs.size() > targetNoWs.size() && resultNoWs.compare( 0, targetNoWs.size(), targetNoWs ) == 0 )
-            rank = PrefixNoWsMatch * Multiplier + saturated( i->first.size() );
-          else
-            rank = WorstMatch * Multiplier;
+  vector< ResultsArray::const_iterator > best;
+  best.reserve( resultsArray.size() );
 
-          if ( i->second->rank > rank )
-            i->second->rank = rank; // We store the best rank of any writing
-        }
-      }
-  
-      resultsArray.sort( SortByRank() );
-    }
-    else
-    if( searchType == StemmedMatch )
-    {
-      // Handling stemmed matches
-
-      // We use two factors -- first is the number of characters strings share
-      // in their beginnings, and second, the length of the strings. Here we assign
-      // only the first one, storing it in rank. Then we sort the results using
-      // SortByRankAndLength.
-      for( unsigned wr = 0; wr < allWordWritings.size(); ++wr )
-      {
-        wstring target = Folding::apply( allWordWritings[ wr ] );
-  
-        for( ResultsIndex::const_iterator i = resultsIndex.begin(), j = resultsIndex.end();
-             i != j; ++i )
-        {
-          wstring resultFolded = Folding::apply( i->first );
-  
-          int charsInCommon = 0;
-  
-          for( wchar const * t = target.c_str(), * r = resultFolded.c_str();
-               *t && *t == *r; ++t, ++r, ++charsInCommon ) ;
-  
-          int rank = -charsInCommon; // Negated so the lesser-than
-                                     // comparison would yield right
-                                     // results.
+  for( ResultsArray::const_iterator i = resultsArray.begin(), j = resultsArray.end();
+       i != j; ++i )
+    best.push_back( i );
 
-          if ( i->second->rank > rank )
-            i->second->rank = rank; // We store the best rank of any writing
-        }
-      }
-      
-      resultsArray.sort( SortByRankAndLength() );
+  size_t const resultsCount = std::min( best.size(), maxSearchResults );
 
-      maxSearchResults = 15;
-    }
-  }
+  if ( searchType == PrefixMatch )
+    std::partial_sort( best.begin(), best.begin() + resultsCount, best.end(), SortByRank() );
+  else
+  if ( searchType == StemmedMatch )
+    std::partial_sort( best.begin(), best.begin() + resultsCount, best.end(), SortByRankAndLength() );
 
   searchResults.clear();
-  searchResults.reserve( resultsArray.size() < maxSearchResults ? resultsArray.size() : maxSearchResults );
+  searchResults.reserve( resultsCount );
 
-  for( ResultsArray::const_iterator i = resultsArray.begin(), j = resultsArray.end();
-       i != j; ++i )
+  for( size_t x = 0; x < resultsCount; ++x )
   {
     //GD_DPRINTF( "%d: %ls\n", i->second, i->first.c_str() );
 
-    if ( searchResults.size() < maxSearchResults )
-      searchResults.push_back( std::pair< QString, bool >( QString::fromStdU32String( i->word ), i->wasSuggested ) );
-    else
-      break;
+    searchResults.push_back( std::pair< QString, bool >( QString::fromStdU32String( best[ x ]->word ), best[ x ]->wasSuggested ) );
   }
 
-  if ( queuedRequests.size() )
+  if ( queuedRequests.size() || alternateWritingsPending )
   {
     // There are still some unhandled results.
     emit updated();
@@ -7,6 +7,7 @@
 #include <list>
 #include <map>
 #include <QObject>
+#include <QFutureWatcher>
 #include <QTimer>
 #include <QMutex>
 #include <QWaitCondition>
@@ -52,7 +53,59 @@ private:
   std::vector< sptr< Dictionary::Class > > const * inputDicts;
 
   std::vector< gd::wstring > allWordWritings; // All writings of the inputWord
-  
+
+  /// Folded forms of one of the writings, computed once per search so that
+  /// ranking a result doesn't need to fold the target over and over again
+  struct FoldedWriting
+  {
+    gd::wstring target, targetNoFullCase, targetNoDia, targetNoPunct, targetNoWs;
+  };
+
+  std::vector< FoldedWriting > foldedWritings;
+
+  /// Prefix search results of one dictionary
+  struct CachedResults
+  {
+    std::vector< Dictionary::WordMatch > matches;
+    bool complete; // All the matches are there, none were cut by maxResults
+  };
+
+  /// The results of one of the recent prefix searches, per dictionary id.
+  /// When the user types on, the results for the longer query are picked
+  /// from the ones of the shorter query instead of searching the index again.
+  /// When the user erases a character, the earlier results are reused as is.
+  struct RecentSearch
+  {
+    gd::wstring folded;
+    unsigned long maxResults;
+    std::map< std::string, CachedResults > results;
+  };
+
+  std::list< RecentSearch > recentSearches;
+
+  /// Requests whose results are to be saved to the current recent search
+  std::map< Dictionary::WordSearchRequest const *, std::string > cacheableRequests;
+
+  /// Alternate writings are generated in a worker thread, so that the search
+  /// for the word as typed doesn't wait for them. The writings of each
+  /// dictionary are kept in a small LRU cache, most recently used first.
+  typedef std::vector< std::vector< gd::wstring > > AlternateWritings;
+
+  struct CachedWritings
+  {
+    std::string dictId;
+    gd::wstring word;
+    std::vector< gd::wstring > writings;
+  };
+
+  std::list< CachedWritings > writingsCache;
+  std::map< std::pair< std::string, gd::wstring >, std::list< CachedWritings >::iterator > writingsCacheIndex;
+
+  QFutureWatcher< AlternateWritings > alternateWritingsWatcher;
+  gd::wstring alternateWritingsJobWord; // The word the running job is working on
+  std::vector< std::string > alternateWritingsJobDicts; // Ids of its dictionaries
+  bool alternateWritingsPending; // The current search still waits for its alternate writings
+
   struct OneResult
   {
     gd::wstring word;
@@ -143,6 +196,9 @@ private slots:
   /// Called by updateResultsTimer to update searchResults and signal updated()
   void updateResults();
 
+  /// Called when the alternate writings job is done
+  void alternateWritingsReady();
+
 private:
 
   // Starts the previously queued search.
@@ -152,10 +208,44 @@ private:
   // would cancel in parallel.
   void cancelSearches();
 
+  /// Queues the search requests for the word writings starting with the given
+  /// one. If folded is given, the word as typed is looked up in the recent
+  /// searches first.
+  void queueSearches( size_t firstWriting, gd::wstring const * folded = nullptr );
+
+  /// Adds the alternate writings of the current search from the cache, or
+  /// starts a job generating the missing ones.
+  void startAlternateWritings();
+
+  /// Adds the given alternate writings to the current search, re-ranks the
+  /// results so far and queues the searches for the new writings.
+  void addAlternateWritings( std::vector< gd::wstring > const & );
+
+  /// Computes the folded forms of all the word writings for the ranking.
+  void prepareFoldedWritings();
+
+  /// Makes the results of the given dictionary for the current search out of
+  /// the recent searches, if possible. Returns an empty pointer otherwise.
+  sptr< Dictionary::WordSearchRequest > findInRecentSearches( Dictionary::Class & dict,
+                                                              gd::wstring const & folded );
+
+  /// Saves the results of the finished request to the current recent search,
+  /// if the request is one of the cacheable ones.
+  void cacheRequestResults( Dictionary::WordSearchRequest & );
+
+  /// Returns the rank of the given result, lowercased, against the best
+  /// matching writing. Every result is only ranked once, when it arrives.
+  int rankResult( gd::wstring const & lowerCased ) const;
+
   /// Compares results based on their ranks
   struct SortByRank
   {
-    bool operator () ( OneResult const & first, OneResult const & second )
+    bool operator () ( ResultsArray::const_iterator first, ResultsArray::const_iterator second ) const
+    {
+      return ( *this )( *first, *second );
+    }
+
+    bool operator () ( OneResult const & first, OneResult const & second ) const
     {
       if ( first.rank < second.rank )
         return true;
@@ -172,7 +262,12 @@ private:
   /// Compares results based on their ranks and lengths
   struct SortByRankAndLength
   {
-    bool operator () ( OneResult const & first, OneResult const & second )
+    bool operator () ( ResultsArray::const_iterator first, ResultsArray::const_iterator second ) const
+    {
+      return ( *this )( *first, *second );
+    }
+
+    bool operator () ( OneResult const & first, OneResult const & second ) const
     {
       if ( first.rank < second.rank )
         return true;
@@ -46,10 +46,33 @@ void WordList::updateMatchResults( bool finished )
   WordFinder::SearchResults const & results = wordFinder->getResults();
 
   setUpdatesEnabled( false );
-  //clear all existed items
-  clear();
 
-  for( unsigned x = 0; x < results.size(); ++x )
+  // Only touch the items which have actually changed since the previous
+  // update, the list is mostly the same while the results keep coming in
+  int const common = qMin( count(), (int)results.size() );
+
+  for( int x = 0; x < common; ++x )
+  {
+    QListWidgetItem * i = item( x );
+
+    if( i->text() != results[ x ].first )
+    {
+      i->setText( results[ x ].first );
+      i->setToolTip( results[ x ].first );
+    }
+
+    if( i->font().italic() != results[ x ].second )
+    {
+      QFont f = i->font();
+      f.setItalic( results[ x ].second );
+      i->setFont( f );
+    }
+  }
+
+  while( count() > (int)results.size() )
+    delete takeItem( count() - 1 );
+
+  for( unsigned x = common; x < results.size(); ++x )
   {
     QListWidgetItem * i = new QListWidgetItem( results[ x ].first, this );
     i->setToolTip( results[ x ].first );
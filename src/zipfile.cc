@@ -193,6 +193,37 @@ bool readLocalHeader( SplitZipFile & zip, LocalFileHeader & entry )
   return true;
 }
 
+bool readLocalHeaderAt( SplitZipFile const & zip, quint64 offset, LocalFileHeader & entry, quint64 & dataOffset )
+{
+  LocalFileHeaderRecord record;
+
+  if ( zip.readAt( offset, (char *)&record, sizeof( record ) ) != sizeof( record ) )
+    return false;
+
+  if ( record.signature != localFileHeaderSignature )
+    return false;
+
+  offset += sizeof( record );
+
+  // Read file name
+
+  int fileNameLength = qFromLittleEndian( record.fileNameLength );
+  entry.fileName = zip.readAt( offset, fileNameLength );
+
+  if ( entry.fileName.size() != fileNameLength )
+    return false;
+
+  // Skip extra field
+
+  dataOffset = offset + fileNameLength + qFromLittleEndian( record.extraFieldLength );
+
+  entry.compressedSize = qFromLittleEndian( record.compressedSize );
+  entry.uncompressedSize = qFromLittleEndian( record.uncompressedSize );
+  entry.compressionMethod = getCompressionMethod( record.compressionMethod );
+
+  return true;
+}
+
 SplitZipFile::SplitZipFile( const QString & name )
 {
   setFileName( name );
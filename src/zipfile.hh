@@ -73,6 +73,11 @@ bool readNextEntry( SplitZipFile &, CentralDirEntry & );
 /// Returns true on success, false otherwise.
 bool readLocalHeader( SplitZipFile &, LocalFileHeader & );
 
+/// Reads local file header at the given offset without using the current
+/// position of the zip, so it is safe to call from several threads at once.
+/// On success, dataOffset receives the offset of the file data.
+bool readLocalHeaderAt( SplitZipFile const &, quint64 offset, LocalFileHeader &, quint64 & dataOffset );
+
 }
 
 #endif
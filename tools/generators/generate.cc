@@ -7,12 +7,15 @@
 // the data files were updated to avoid the hurdles an end user might get
 // into while compiling the program.
 
+#include <stdint.h>
 #include <stdio.h>
 #include <map>
 #include <string>
+#include <vector>
 
 using std::map;
 using std::u32string;
+using std::vector;
 
 struct Node
 {
@@ -25,6 +28,60 @@ struct Node
   }
 };
 
+enum {
+  BlockBits = 8,
+  BlockSize = 1 << BlockBits,
+  TotalBlocks = 0x110000 >> BlockBits,
+  MultiBase = 0x20000000
+};
+
+/// Writes a two-level table of the given deltas, named name + "Blocks" for
+/// the first level and name + "Deltas" for the second one.
+void writeTable( FILE * outf, char const * name, map< char32_t, int32_t > const & deltas )
+{
+  vector< vector< int32_t > > blocks( 1, vector< int32_t >( BlockSize, 0 ) ); // Block 0 is the empty one
+  vector< unsigned > blockIndex( TotalBlocks, 0 );
+
+  for ( unsigned b = 0; b < TotalBlocks; ++b ) {
+    vector< int32_t > block( BlockSize, 0 );
+
+    for ( map< char32_t, int32_t >::const_iterator i = deltas.lower_bound( b << BlockBits );
+          i != deltas.end() && ( i->first >> BlockBits ) == b;
+          ++i )
+      block[ i->first & ( BlockSize - 1 ) ] = i->second;
+
+    unsigned x;
+    for ( x = 0; x < blocks.size(); ++x )
+      if ( blocks[ x ] == block )
+        break;
+
+    if ( x == blocks.size() )
+      blocks.push_back( block );
+
+    blockIndex[ b ] = x;
+  }
+
+  fprintf( outf, "static uint16_t const %sBlocks[ 0x%x ] = {", name, TotalBlocks );
+
+  for ( unsigned b = 0; b < TotalBlocks; ++b )
+    fprintf( outf, "%s%u,", b % 16 ? " " : "\n  ", blockIndex[ b ] );
+
+  fprintf( outf, "\n};\n\n" );
+
+  fprintf( outf, "static int32_t const %sDeltas[ %u ][ 0x%x ] = {\n", name, (unsigned)blocks.size(), BlockSize );
+
+  for ( size_t x = 0; x < blocks.size(); ++x ) {
+    fprintf( outf, "  {" );
+
+    for ( unsigned y = 0; y < BlockSize; ++y )
+      fprintf( outf, "%s%d,", y % 16 ? " " : "\n    ", blocks[ x ][ y ] );
+
+    fprintf( outf, "\n  },\n" );
+  }
+
+  fprintf( outf, "};\n\n" );
+}
+
 void indent( FILE * outf, size_t steps )
 {
   for ( unsigned x = steps; x--; )
@@ -165,31 +222,88 @@ int main()
     fprintf( outf, "// This file was generated automatically. Do not edit directly.\n\n" );
 
     fprintf( outf, "enum { foldCaseMaxOut = 3 };\n\n" );
-    fprintf( outf, "size_t foldCase( wchar in, wchar * out )\n{\n  switch( in )\n  {\n" );
+
+    // Both foldings are done with two-level lookup tables: the high bits of
+    // a code point select a block, the low ones an entry in it. An entry is
+    // the delta to add to the code point. Blocks with no foldings in them
+    // are all shared.
+
+    map< char32_t, int32_t > simpleDeltas;
+
+    for ( map< char32_t, char32_t >::const_iterator i = simpleFoldTable.begin(); i != simpleFoldTable.end(); ++i )
+      simpleDeltas[ i->first ] = (int32_t)i->second - (int32_t)i->first;
+
+    // The multi-char foldings are stored separately, their entries hold
+    // their index plus foldCaseMultiBase, which no delta can reach.
+
+    map< char32_t, int32_t > fullDeltas;
+    vector< u32string > multi;
 
     for ( map< char32_t, u32string >::const_iterator i = foldTable.begin(); i != foldTable.end(); ++i ) {
       if ( i->second.size() == 1 )
-        fprintf( outf, "    case 0x%x: *out = 0x%x; return 1;\n", i->first, i->second[ 0 ] );
+        fullDeltas[ i->first ] = (int32_t)i->second[ 0 ] - (int32_t)i->first;
       else {
-        fprintf( outf, "    case 0x%x: ", i->first );
-
-        for ( unsigned x = 0; x < i->second.size(); ++x )
-          fprintf( outf, "out[ %u ] = 0x%x; ", x, i->second[ x ] );
-
-        fprintf( outf, "return %u;\n", i->second.size() );
+        fullDeltas[ i->first ] = MultiBase + (int32_t)multi.size();
+        multi.push_back( i->second );
       }
     }
 
-    fprintf( outf, "    default: *out = in; return 1;\n" );
-    fprintf( outf, "  }\n}\n\n" );
+    fprintf( outf, "enum { foldCaseMultiBase = 0x%x };\n\n", MultiBase );
 
-    fprintf( outf, "wchar foldCaseSimple( wchar in )\n{\n  switch( in )\n  {\n" );
+    writeTable( outf, "foldCaseTable", fullDeltas );
 
-    for ( map< char32_t, char32_t >::const_iterator i = simpleFoldTable.begin(); i != simpleFoldTable.end(); ++i )
-      fprintf( outf, "    case 0x%x: return 0x%x;\n", i->first, i->second );
+    fprintf( outf, "static wchar const foldCaseMulti[][ foldCaseMaxOut + 1 ] = {\n" );
+
+    for ( size_t x = 0; x < multi.size(); ++x ) {
+      fprintf( outf, "  { %u", (unsigned)multi[ x ].size() );
+
+      for ( unsigned y = 0; y < 3; ++y )
+        fprintf( outf, ", 0x%x", y < multi[ x ].size() ? (unsigned)multi[ x ][ y ] : 0 );
+
+      fprintf( outf, " },\n" );
+    }
 
-    fprintf( outf, "    default: return in;\n" );
-    fprintf( outf, "  }\n}\n" );
+    fprintf( outf, "};\n\n" );
+
+    writeTable( outf, "foldCaseSimpleTable", simpleDeltas );
+
+    fprintf( outf,
+             "size_t foldCase( wchar in, wchar * out )\n"
+             "{\n"
+             "  if ( in > 0x10FFFF )\n"
+             "  {\n"
+             "    *out = in;\n"
+             "    return 1;\n"
+             "  }\n"
+             "\n"
+             "  int32_t delta = foldCaseTableDeltas[ foldCaseTableBlocks[ in >> %u ] ][ in & 0x%x ];\n"
+             "\n"
+             "  if ( delta < foldCaseMultiBase )\n"
+             "  {\n"
+             "    *out = in + delta;\n"
+             "    return 1;\n"
+             "  }\n"
+             "\n"
+             "  wchar const * entry = foldCaseMulti[ delta - foldCaseMultiBase ];\n"
+             "\n"
+             "  for ( unsigned x = 0; x < entry[ 0 ]; ++x )\n"
+             "    out[ x ] = entry[ x + 1 ];\n"
+             "\n"
+             "  return entry[ 0 ];\n"
+             "}\n\n",
+             BlockBits,
+             BlockSize - 1 );
+
+    fprintf( outf,
+             "wchar foldCaseSimple( wchar in )\n"
+             "{\n"
+             "  if ( in > 0x10FFFF )\n"
+             "    return in;\n"
+             "\n"
+             "  return in + foldCaseSimpleTableDeltas[ foldCaseSimpleTableBlocks[ in >> %u ] ][ in & 0x%x ];\n"
+             "}\n",
+             BlockBits,
+             BlockSize - 1 );
 
     fclose( outf );
   }